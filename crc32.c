@@ -0,0 +1,191 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "crc32.h"
+
+#include <stdbool.h>
+
+static const uint32_t kCrc32Polynomial = 0xedb88320;
+static const uint32_t kCrc32cPolynomial = 0x82f63b78;
+
+typedef uint32_t crc_table_t[256];
+
+// One set of tables per path, so that a path only pulls in its own tables.
+static crc_table_t crc32_table[1];
+static crc_table_t crc32_slice4_tables[4];
+static crc_table_t crc32_slice8_tables[8];
+static crc_table_t crc32c_table[1];
+static crc_table_t crc32c_slice4_tables[4];
+static crc_table_t crc32c_slice8_tables[8];
+
+static volatile bool crc32_table_ready;
+static volatile bool crc32_slice4_tables_ready;
+static volatile bool crc32_slice8_tables_ready;
+static volatile bool crc32c_table_ready;
+static volatile bool crc32c_slice4_tables_ready;
+static volatile bool crc32c_slice8_tables_ready;
+
+/**
+ * Returns `tables`, generating them first if needed.
+ *
+ * `tables[0]` is the byte at a time table; `tables[k]` advances the CRC of a
+ * byte over `k` further zero bytes, for slicing. `*ready` is only set once
+ * all of them are complete. An ISR that preempts the generation sees them as
+ * not ready and generates them itself; both write the same values.
+ */
+static const crc_table_t *crc_tables(uint32_t polynomial, crc_table_t *tables,
+                                     size_t count, volatile bool *ready) {
+  if (*ready) {
+    __atomic_signal_fence(__ATOMIC_ACQUIRE);
+    return tables;
+  }
+
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (polynomial & -(crc & 1));
+    }
+    tables[0][i] = crc;
+  }
+  for (size_t k = 1; k < count; ++k) {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = tables[k - 1][i];
+      tables[k][i] = (crc >> 8) ^ tables[0][crc & 0xff];
+    }
+  }
+
+  // The tables must be complete before they are marked as ready.
+  __atomic_signal_fence(__ATOMIC_RELEASE);
+  *ready = true;
+  return tables;
+}
+
+static inline uint32_t load32_le(const uint8_t *data) {
+  return (uint32_t)data[0] | (uint32_t)data[1] << 8 |
+         (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+static uint32_t crc_update_bytewise(uint32_t polynomial, uint32_t crc,
+                                    const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (polynomial & -(crc & 1));
+    }
+  }
+  return crc;
+}
+
+static uint32_t crc_update_table(const crc_table_t *t, uint32_t crc,
+                                 const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    crc = (crc >> 8) ^ t[0][(crc ^ data[i]) & 0xff];
+  }
+  return crc;
+}
+
+static uint32_t crc_update_slice4(const crc_table_t *t, uint32_t crc,
+                                  const uint8_t *data, size_t len) {
+  for (; len >= 4; data += 4, len -= 4) {
+    crc ^= load32_le(data);
+    crc = t[3][crc & 0xff] ^ t[2][(crc >> 8) & 0xff] ^
+          t[1][(crc >> 16) & 0xff] ^ t[0][crc >> 24];
+  }
+  return crc_update_table(t, crc, data, len);
+}
+
+static uint32_t crc_update_slice8(const crc_table_t *t, uint32_t crc,
+                                  const uint8_t *data, size_t len) {
+  for (; len >= 8; data += 8, len -= 8) {
+    uint32_t lo = crc ^ load32_le(data);
+    uint32_t hi = load32_le(data + 4);
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^
+          t[4][lo >> 24] ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+          t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+  }
+  return crc_update_table(t, crc, data, len);
+}
+
+uint32_t crc32_update_bytewise(uint32_t crc, const uint8_t *data, size_t len) {
+  return crc_update_bytewise(kCrc32Polynomial, crc, data, len);
+}
+
+uint32_t crc32_update_table(uint32_t crc, const uint8_t *data, size_t len) {
+  const crc_table_t *tables =
+      crc_tables(kCrc32Polynomial, crc32_table, 1, &crc32_table_ready);
+  return crc_update_table(tables, crc, data, len);
+}
+
+uint32_t crc32_update_slice4(uint32_t crc, const uint8_t *data, size_t len) {
+  const crc_table_t *tables =
+      crc_tables(kCrc32Polynomial, crc32_slice4_tables, 4,
+                 &crc32_slice4_tables_ready);
+  return crc_update_slice4(tables, crc, data, len);
+}
+
+uint32_t crc32_update_slice8(uint32_t crc, const uint8_t *data, size_t len) {
+  const crc_table_t *tables =
+      crc_tables(kCrc32Polynomial, crc32_slice8_tables, 8,
+                 &crc32_slice8_tables_ready);
+  return crc_update_slice8(tables, crc, data, len);
+}
+
+uint32_t crc32c_update_bytewise(uint32_t crc, const uint8_t *data, size_t len) {
+  return crc_update_bytewise(kCrc32cPolynomial, crc, data, len);
+}
+
+uint32_t crc32c_update_table(uint32_t crc, const uint8_t *data, size_t len) {
+  const crc_table_t *tables =
+      crc_tables(kCrc32cPolynomial, crc32c_table, 1, &crc32c_table_ready);
+  return crc_update_table(tables, crc, data, len);
+}
+
+uint32_t crc32c_update_slice4(uint32_t crc, const uint8_t *data, size_t len) {
+  const crc_table_t *tables =
+      crc_tables(kCrc32cPolynomial, crc32c_slice4_tables, 4,
+                 &crc32c_slice4_tables_ready);
+  return crc_update_slice4(tables, crc, data, len);
+}
+
+uint32_t crc32c_update_slice8(uint32_t crc, const uint8_t *data, size_t len) {
+  const crc_table_t *tables =
+      crc_tables(kCrc32cPolynomial, crc32c_slice8_tables, 8,
+                 &crc32c_slice8_tables_ready);
+  return crc_update_slice8(tables, crc, data, len);
+}
+
+#if CRC32_IMPL == CRC32_IMPL_BYTEWISE
+#define CRC32_UPDATE crc32_update_bytewise
+#define CRC32C_UPDATE crc32c_update_bytewise
+#elif CRC32_IMPL == CRC32_IMPL_TABLE
+#define CRC32_UPDATE crc32_update_table
+#define CRC32C_UPDATE crc32c_update_table
+#elif CRC32_IMPL == CRC32_IMPL_SLICE4
+#define CRC32_UPDATE crc32_update_slice4
+#define CRC32C_UPDATE crc32c_update_slice4
+#elif CRC32_IMPL == CRC32_IMPL_SLICE8
+#define CRC32_UPDATE crc32_update_slice8
+#define CRC32C_UPDATE crc32c_update_slice8
+#else
+#error "Unknown CRC32_IMPL"
+#endif
+
+uint32_t crc32_init(void) { return 0xffffffff; }
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+  return CRC32_UPDATE(crc, data, len);
+}
+
+uint32_t crc32_finish(uint32_t crc) { return ~crc; }
+
+uint32_t crc32(const uint8_t *data, size_t len) {
+  return crc32_finish(crc32_update(crc32_init(), data, len));
+}
+
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t len) {
+  return CRC32C_UPDATE(crc, data, len);
+}
+
+uint32_t crc32c(const uint8_t *data, size_t len) {
+  return crc32_finish(crc32c_update(crc32_init(), data, len));
+}
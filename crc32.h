@@ -0,0 +1,92 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_CRC32_H_
+#define ATHOS_SW_DIF_SMOKETEST_CRC32_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Streaming CRC-32 and CRC-32C.
+ *
+ * CRC-32 is the IEEE 802.3 CRC (reflected polynomial 0xEDB88320), CRC-32C the
+ * Castagnoli CRC (reflected polynomial 0x82F63B78); both use an initial value
+ * and final XOR of 0xFFFFFFFF.
+ *
+ * A CRC over a stream is computed with `crc32_init()`, any number of
+ * `crc32_update()` calls over consecutive pieces of the stream, and
+ * `crc32_finish()`; the result does not depend on how the stream is split.
+ *
+ * Every update path is available under its own name; `crc32_update()` and
+ * `crc32c_update()` use the one selected by `CRC32_IMPL`:
+ *
+ * - `CRC32_IMPL_BYTEWISE`: bit at a time, no table.
+ * - `CRC32_IMPL_TABLE`: byte at a time, 1 KiB table per polynomial.
+ * - `CRC32_IMPL_SLICE4`: 4 bytes at a time, 4 KiB of tables per polynomial.
+ * - `CRC32_IMPL_SLICE8`: 8 bytes at a time, 8 KiB of tables per polynomial.
+ *
+ * The tables live in .bss and are generated on first use, so that only the
+ * paths a program actually calls take up code and RAM once unused sections
+ * are garbage collected.
+ */
+
+#define CRC32_IMPL_BYTEWISE 0
+#define CRC32_IMPL_TABLE 1
+#define CRC32_IMPL_SLICE4 2
+#define CRC32_IMPL_SLICE8 3
+
+#ifndef CRC32_IMPL
+#define CRC32_IMPL CRC32_IMPL_TABLE
+#endif
+
+/**
+ * Returns the running CRC of an empty stream.
+ */
+uint32_t crc32_init(void);
+
+/**
+ * Extends the running CRC-32 `crc` over `len` bytes of `data`.
+ *
+ * @return The updated running CRC.
+ */
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len);
+
+/**
+ * Returns the CRC of the stream covered by the running CRC `crc`.
+ */
+uint32_t crc32_finish(uint32_t crc);
+
+/**
+ * Returns the CRC-32 of `len` bytes of `data`.
+ */
+uint32_t crc32(const uint8_t *data, size_t len);
+
+/**
+ * Extends the running CRC-32C `crc` over `len` bytes of `data`.
+ *
+ * Starts from `crc32_init()` and ends with `crc32_finish()`, like CRC-32.
+ *
+ * @return The updated running CRC.
+ */
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t len);
+
+/**
+ * Returns the CRC-32C of `len` bytes of `data`.
+ */
+uint32_t crc32c(const uint8_t *data, size_t len);
+
+/**
+ * `crc32_update()` / `crc32c_update()` through a given path, regardless of
+ * `CRC32_IMPL`.
+ */
+uint32_t crc32_update_bytewise(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32_update_table(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32_update_slice4(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32_update_slice8(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32c_update_bytewise(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32c_update_table(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32c_update_slice4(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32c_update_slice8(uint32_t crc, const uint8_t *data, size_t len);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_CRC32_H_
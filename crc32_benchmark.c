@@ -0,0 +1,129 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "base/memory.h"
+#include "dif/device.h"
+#include "dif/ibex.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "crc32.h"
+
+/**
+ * CRC-32 / CRC-32C benchmark.
+ *
+ * Checks every update path against the standard check values and against
+ * each other, then times each of them and emits one result line per run:
+ *
+ *   BENCH crc poly=<crc32|crc32c> impl=<bytewise|table|slice4|slice8>
+ *         bytes=<u> cycles=<u> cycles_per_byte_x100=<u>
+ *
+ * (on a single line). Tables are generated before timing.
+ */
+
+typedef uint32_t (*crc_update_fn_t)(uint32_t crc, const uint8_t *data,
+                                    size_t len);
+
+typedef struct crc_impl {
+  const char *name;
+  crc_update_fn_t crc32;
+  crc_update_fn_t crc32c;
+} crc_impl_t;
+
+static const crc_impl_t kImpls[] = {
+    {"bytewise", crc32_update_bytewise, crc32c_update_bytewise},
+    {"table", crc32_update_table, crc32c_update_table},
+    {"slice4", crc32_update_slice4, crc32c_update_slice4},
+    {"slice8", crc32_update_slice8, crc32c_update_slice8},
+};
+
+static const size_t kPayloadSizes[] = {64, 1024, 4096};
+
+/**
+ * Largest payload run in simulation; the bigger ones take too long there.
+ */
+static const size_t kPayloadMaxSizeSim = 64;
+
+static const uint8_t kCheckInput[] = "123456789";
+static const uint32_t kCrc32Check = 0xcbf43926;
+static const uint32_t kCrc32cCheck = 0xe3069283;
+
+static uint8_t payload[4096];
+
+/**
+ * Keeps the timed CRCs from being optimised away.
+ */
+static volatile uint32_t crc_sink;
+
+static uint32_t crc_of(crc_update_fn_t update, const uint8_t *data,
+                       size_t len) {
+  return crc32_finish(update(crc32_init(), data, len));
+}
+
+/**
+ * Checks `update` against `check`, and against the bytewise path over an
+ * unaligned, unevenly split payload.
+ */
+static void check_impl(const char *name, crc_update_fn_t update,
+                       crc_update_fn_t reference, uint32_t check) {
+  uint32_t crc = crc_of(update, kCheckInput, sizeof(kCheckInput) - 1);
+  CHECK(crc == check, "%s: check value 0x%x, expected 0x%x", name, crc, check);
+
+  uint32_t expected = crc_of(reference, &payload[1], 1021);
+  crc = crc32_init();
+  crc = update(crc, &payload[1], 13);
+  crc = update(crc, &payload[14], 1008);
+  crc = crc32_finish(crc);
+  CHECK(crc == expected, "%s: split CRC 0x%x, expected 0x%x", name, crc,
+        expected);
+}
+
+static void run_benchmark(const char *poly, const char *impl,
+                          crc_update_fn_t update, size_t len) {
+  uint64_t start = ibex_mcycle_read();
+  crc_sink = update(crc32_init(), payload, len);
+  uint64_t cycles = ibex_mcycle_read() - start;
+
+  LOG_INFO(
+      "BENCH crc poly=%s impl=%s bytes=%u cycles=%u cycles_per_byte_x100=%u",
+      poly, impl, len, (uint32_t)cycles, (uint32_t)(cycles * 100 / len));
+}
+
+const test_config_t kTestConfig;
+
+bool test_main(void) {
+  LOG_INFO("Running crc32 benchmark");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+
+  for (size_t i = 0; i < ARRAYSIZE(payload); ++i) {
+    payload[i] = (uint8_t)(i * 151 + (i >> 7));
+  }
+
+  // Also generates the tables, keeping that out of the timed runs.
+  for (int i = 0; i < ARRAYSIZE(kImpls); ++i) {
+    check_impl(kImpls[i].name, kImpls[i].crc32, crc32_update_bytewise,
+               kCrc32Check);
+    check_impl(kImpls[i].name, kImpls[i].crc32c, crc32c_update_bytewise,
+               kCrc32cCheck);
+  }
+  CHECK(crc32(kCheckInput, sizeof(kCheckInput) - 1) == kCrc32Check);
+  CHECK(crc32c(kCheckInput, sizeof(kCheckInput) - 1) == kCrc32cCheck);
+
+  for (int s = 0; s < ARRAYSIZE(kPayloadSizes); ++s) {
+    if (is_sim && kPayloadSizes[s] > kPayloadMaxSizeSim) {
+      break;
+    }
+    for (int i = 0; i < ARRAYSIZE(kImpls); ++i) {
+      run_benchmark("crc32", kImpls[i].name, kImpls[i].crc32,
+                    kPayloadSizes[s]);
+      run_benchmark("crc32c", kImpls[i].name, kImpls[i].crc32c,
+                    kPayloadSizes[s]);
+    }
+  }
+
+  LOG_INFO("Completed Running crc32 benchmark");
+
+  return true;
+}
@@ -7,15 +7,52 @@
 
 #include "base/mmio.h"
 #include "dif/dif_aon_timer.h"
+#include "dif/dif_rv_timer.h"
+#include "dif/handler.h"
 #include "dif/hart.h"
+#include "dif/irq.h"
 #include "dif/log.h"
 #include "dif/check.h"
 #include "dif/test_main.h"
+#include "irq_await.h"
 
 #include "top/sw/autogen/top_athos.h"
 
 const test_config_t kTestConfig;
 
+// The rv_timer comparator that bounds the wait for each AON timer expiry.
+static const uint32_t kHart = (uint32_t)kTopAthosPlicTargetIbex0;
+static const uint32_t kComparator = 0;
+
+// Upper bound for the AON timer to expire; a single count of the 200kHz AON
+// clock, plus clock domain crossing. The wait ends as soon as it has.
+static const uint32_t kExpiryTimeoutUsec = 100;
+
+static dif_rv_timer_t timer;
+
+/**
+ * An AON timer interrupt state waited for.
+ */
+typedef struct aon_timer_irq_ctx {
+  dif_aon_timer_t *aon;
+  dif_aon_timer_irq_t irq;
+} aon_timer_irq_ctx_t;
+
+static bool aon_timer_irq_pending(void *ctx) {
+  const aon_timer_irq_ctx_t *irq = ctx;
+  bool is_pending;
+  CHECK(dif_aon_timer_irq_is_pending(irq->aon, irq->irq, &is_pending) ==
+        kDifAonTimerOk);
+  return is_pending;
+}
+
+/**
+ * Timer interrupt handler
+ *
+ * Only the expiry wait timeout is armed on the timer.
+ */
+void handler_irq_timer(void) { irq_await_handle_timer_irq(); }
+
 static void aon_timer_test_wakeup_timer(dif_aon_timer_t *aon) {
   // Make sure that wake-up timer is stopped.
   CHECK(dif_aon_timer_wakeup_stop(aon) == kDifAonTimerOk);
@@ -28,16 +65,13 @@ static void aon_timer_test_wakeup_timer(dif_aon_timer_t *aon) {
                                      &is_pending) == kDifAonTimerOk);
   CHECK(!is_pending);
 
-  // Test the wake-up timer functionality by setting a single cycle counter.
-  // Delay to compensate for AON Timer 200kHz clock (less should suffice, but
-  // to be on a cautious side - lets keep it at 100 for now).
+  // Test the wake-up timer functionality by setting a single cycle counter,
+  // and wait for the timer to expire. The AON timer interrupt is not routed
+  // to the hart, so its state is polled.
   CHECK(dif_aon_timer_wakeup_start(aon, 1, 0) == kDifAonTimerOk);
-  usleep(100);
-
-  // Make sure that the timer has expired.
-  CHECK(dif_aon_timer_irq_is_pending(aon, kDifAonTimerIrqWakeupThreshold,
-                                     &is_pending) == kDifAonTimerOk);
-  CHECK(is_pending);
+  aon_timer_irq_ctx_t irq = {aon, kDifAonTimerIrqWakeupThreshold};
+  CHECK(irq_await_poll(aon_timer_irq_pending, &irq, kExpiryTimeoutUsec, NULL),
+        "wake-up timer has not expired!");
 
   CHECK(dif_aon_timer_wakeup_stop(aon) == kDifAonTimerOk);
 
@@ -58,16 +92,12 @@ static void aon_timer_test_watchdog_timer(dif_aon_timer_t *aon) {
   CHECK(!is_pending);
 
   // Test the watchdog timer functionality by setting a single cycle "bark"
-  // counter. Delay to compensate for AON Timer 200kHz clock (less should
-  // suffice, but to be on a cautious side - lets keep it at 100 for now).
+  // counter, and wait for the timer to expire.
   CHECK(dif_aon_timer_watchdog_start(aon, 1, 0xffffffff, false, false) ==
         kDifAonTimerWatchdogOk);
-  usleep(100);
-
-  // Make sure that the timer has expired.
-  CHECK(dif_aon_timer_irq_is_pending(aon, kDifAonTimerIrqWatchdogBarkThreshold,
-                                     &is_pending) == kDifAonTimerOk);
-  CHECK(is_pending);
+  aon_timer_irq_ctx_t irq = {aon, kDifAonTimerIrqWatchdogBarkThreshold};
+  CHECK(irq_await_poll(aon_timer_irq_pending, &irq, kExpiryTimeoutUsec, NULL),
+        "watchdog timer has not barked!");
 
   CHECK(dif_aon_timer_watchdog_stop(aon) == kDifAonTimerWatchdogOk);
 
@@ -86,6 +116,14 @@ bool test_main(void) {
   };
   CHECK(dif_aon_timer_init(params, &aon) == kDifAonTimerOk);
 
+  // Initialise the rv_timer for the expiry timeouts.
+  CHECK(dif_rv_timer_init(
+            mmio_region_from_addr(TOP_ATHOS_RV_TIMER_BASE_ADDR),
+            (dif_rv_timer_config_t){.hart_count = 1, .comparator_count = 1},
+            &timer) == kDifRvTimerOk);
+  irq_await_init(&timer, kHart, kComparator);
+  irq_global_ctrl(true);
+
   for (int i = 0; i < 40; i++) {
       aon_timer_test_wakeup_timer(&aon);
       aon_timer_test_watchdog_timer(&aon);
@@ -9,6 +9,7 @@
 #include "dif/dif_clkmgr.h"
 #include "dif/check.h"
 #include "dif/test_main.h"
+#include "profile.h"
 
 #include "top/sw/autogen/top_athos.h"  // Generated.
 
@@ -31,18 +32,22 @@ static void test_gateable_clocks(const dif_clkmgr_t *clkmgr) {
     // disabled depending on reset behavior - either is fine for the purposes of
     // this test.
     bool enabled;
-    CHECK(dif_clkmgr_gateable_clock_get_enabled(clkmgr, clock, &enabled) ==
-          kDifClkmgrOk);
+    CHECK(PROFILE_CALL("dif_clkmgr_gateable_clock_get_enabled initial",
+                       dif_clkmgr_gateable_clock_get_enabled(
+                           clkmgr, clock, &enabled)) == kDifClkmgrOk);
 
     // Toggle the enable twice so that it ends up in its original state.
     for (int j = 0; j < 2; ++j) {
       bool expected = !enabled;
-      CHECK(dif_clkmgr_gateable_clock_set_enabled(
-                clkmgr, clock,
-                expected ? kDifClkmgrToggleEnabled
-                         : kDifClkmgrToggleDisabled) == kDifClkmgrOk);
-      CHECK(dif_clkmgr_gateable_clock_get_enabled(clkmgr, clock, &enabled) ==
+      CHECK(PROFILE_CALL("dif_clkmgr_gateable_clock_set_enabled",
+                         dif_clkmgr_gateable_clock_set_enabled(
+                             clkmgr, clock,
+                             expected ? kDifClkmgrToggleEnabled
+                                      : kDifClkmgrToggleDisabled)) ==
             kDifClkmgrOk);
+      CHECK(PROFILE_CALL("dif_clkmgr_gateable_clock_get_enabled after set",
+                         dif_clkmgr_gateable_clock_get_enabled(
+                             clkmgr, clock, &enabled)) == kDifClkmgrOk);
       CHECK(enabled == expected);
     }
   }
@@ -67,25 +72,32 @@ void test_hintable_clocks(const dif_clkmgr_t *clkmgr) {
     // enabled or disabled depending on reset behavior - either is fine for the
     // purposes of this test.
     bool enabled;
-    CHECK(dif_clkmgr_hintable_clock_get_hint(clkmgr, clock, &enabled) ==
+    CHECK(PROFILE_CALL("dif_clkmgr_hintable_clock_get_hint initial",
+                       dif_clkmgr_hintable_clock_get_hint(clkmgr, clock,
+                                                          &enabled)) ==
           kDifClkmgrOk);
 
     // Toggle the hint twice so that it ends up in its original state.
     for (int j = 0; j < 2; ++j) {
       bool expected = !enabled;
-      CHECK(dif_clkmgr_hintable_clock_set_hint(
-                clkmgr, clock,
-                expected ? kDifClkmgrToggleEnabled
-                         : kDifClkmgrToggleDisabled) == kDifClkmgrOk);
-      CHECK(dif_clkmgr_hintable_clock_get_hint(clkmgr, clock, &enabled) ==
+      CHECK(PROFILE_CALL("dif_clkmgr_hintable_clock_set_hint",
+                         dif_clkmgr_hintable_clock_set_hint(
+                             clkmgr, clock,
+                             expected ? kDifClkmgrToggleEnabled
+                                      : kDifClkmgrToggleDisabled)) ==
+            kDifClkmgrOk);
+      CHECK(PROFILE_CALL("dif_clkmgr_hintable_clock_get_hint after set",
+                         dif_clkmgr_hintable_clock_get_hint(clkmgr, clock,
+                                                            &enabled)) ==
             kDifClkmgrOk);
       CHECK(enabled == expected);
 
       // If the clock hint is enabled then the clock should always be enabled.
       if (enabled) {
         bool status = false;
-        CHECK(dif_clkmgr_hintable_clock_get_enabled(clkmgr, clock, &status) ==
-              kDifClkmgrOk);
+        CHECK(PROFILE_CALL("dif_clkmgr_hintable_clock_get_enabled",
+                           dif_clkmgr_hintable_clock_get_enabled(
+                               clkmgr, clock, &status)) == kDifClkmgrOk);
         CHECK(status, "clock %u hint is enabled but status is disabled", clock);
       }
     }
@@ -100,9 +112,13 @@ bool test_main() {
   };
 
   dif_clkmgr_t clkmgr;
-  CHECK(dif_clkmgr_init(params, &clkmgr) == kDifClkmgrOk);
+  profile_init();
+  CHECK(PROFILE_CALL("dif_clkmgr_init", dif_clkmgr_init(params, &clkmgr)) ==
+        kDifClkmgrOk);
   test_gateable_clocks(&clkmgr);
   test_hintable_clocks(&clkmgr);
 
+  profile_dump();
+
   return true;
 }
@@ -12,6 +12,7 @@
 #include "dif/log.h"
 #include "dif/check.h"
 #include "dif/test_main.h"
+#include "profile.h"
 
 #include "top/sw/autogen/top_athos.h"  // Generated.
 
@@ -50,10 +51,12 @@ static const uint32_t kGpioMask = 0x0000FFFF;
  * @param write_val Value to write.
  */
 static void test_gpio_write(uint32_t write_val) {
-  CHECK(dif_gpio_write_all(&gpio, write_val) == kDifGpioOk);
+  CHECK(PROFILE_CALL("dif_gpio_write_all",
+                     dif_gpio_write_all(&gpio, write_val)) == kDifGpioOk);
 
   uint32_t read_val = 0;
-  CHECK(dif_gpio_read_all(&gpio, &read_val) == kDifGpioOk);
+  CHECK(PROFILE_CALL("dif_gpio_read_all",
+                     dif_gpio_read_all(&gpio, &read_val)) == kDifGpioOk);
 
   uint32_t expected = write_val & kGpioMask;
   uint32_t actual = read_val & kGpioMask;
@@ -67,12 +70,18 @@ static void test_gpio_write(uint32_t write_val) {
  * NOTE: This test can currently run only on FPGA and DV.
  */
 bool test_main(void) {
-  CHECK(dif_gpio_init(
-            (dif_gpio_params_t){
-                .base_addr = mmio_region_from_addr(TOP_ATHOS_GPIO_BASE_ADDR),
-            },
-            &gpio) == kDifGpioOk);
-  CHECK(dif_gpio_output_set_enabled_all(&gpio, kGpioMask) == kDifGpioOk);
+  profile_init();
+  CHECK(PROFILE_CALL(
+            "dif_gpio_init",
+            dif_gpio_init(
+                (dif_gpio_params_t){
+                    .base_addr =
+                        mmio_region_from_addr(TOP_ATHOS_GPIO_BASE_ADDR),
+                },
+                &gpio)) == kDifGpioOk);
+  CHECK(PROFILE_CALL("dif_gpio_output_set_enabled_all",
+                     dif_gpio_output_set_enabled_all(&gpio, kGpioMask)) ==
+        kDifGpioOk);
 
   for (uint8_t i = 0; i < ARRAYSIZE(kGpioVals); ++i) {
     test_gpio_write(kGpioVals[i]);
@@ -85,5 +94,7 @@ bool test_main(void) {
     test_gpio_write(~i);
   }
 
+  profile_dump();
+
   return true;
 }
@@ -0,0 +1,197 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_plic.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/dif_uart.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "irq_lock.h"
+#include "plic_batch.h"
+#include "plic_dispatch.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+#include "uart_regs.h"                 // Generated.
+
+/**
+ * PLIC interrupt burst benchmark.
+ *
+ * Forces N UART interrupts back to back while interrupts are masked, then
+ * unmasks them and times how long it takes until all N have been serviced,
+ * with one claim per trap and with claim-until-empty draining. Emits one
+ * result line per run:
+ *
+ *   BENCH plic_burst mode=<single|drain> irqs=<u> cycles=<u> traps=<u>
+ *
+ * (on a single line), where `cycles` and `traps` are per burst, averaged
+ * over `kBurstRounds` bursts.
+ */
+
+static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
+
+static const uint32_t kBurstSizes[] = {1, 2, 4, 8};
+
+/**
+ * Bursts per run.
+ */
+static const uint32_t kBurstRounds = 32;
+
+static const char *const kModeNames[] = {
+    [kPlicDispatchModeSingle] = "single",
+    [kPlicDispatchModeDrain] = "drain",
+};
+
+typedef struct burst_result {
+  uint32_t cycles;
+  uint32_t traps;
+} burst_result_t;
+
+/**
+ * Results are only logged once all runs are done, as the console output
+ * raises UART interrupts itself.
+ */
+static burst_result_t results[ARRAYSIZE(kBurstSizes)][ARRAYSIZE(kModeNames)];
+
+static dif_plic_t plic0;
+static dif_uart_t uart0;
+
+static volatile uint32_t irqs_handled;
+
+/**
+ * External interrupt handler
+ */
+void handler_irq_external(void) { plic_dispatch_handle(); }
+
+/**
+ * UART interrupt handler; acknowledges and counts the interrupt.
+ */
+static void handle_uart_isr(void *ctx, dif_plic_irq_id_t interrupt_id) {
+  // PLIC IRQ IDs of a UART instance are laid out in `dif_uart_irq_t` order.
+  dif_uart_irq_t uart_irq =
+      (dif_uart_irq_t)(interrupt_id - kTopAthosPlicIrqIdUart0TxWatermark);
+  CHECK(dif_uart_irq_acknowledge(&uart0, uart_irq) == kDifUartOk,
+        "ISR failed to clear IRQ!");
+  ++irqs_handled;
+}
+
+static void uart_configure_irqs(dif_uart_t *uart, dif_uart_toggle_t state) {
+  for (dif_uart_irq_t irq = 0; irq <= kDifUartIrqLast; ++irq) {
+    CHECK(dif_uart_irq_set_enabled(uart, irq, state) == kDifUartOk,
+          "UART IRQ enable failed!");
+  }
+}
+
+static void plic_configure_irqs(dif_plic_t *plic) {
+  plic_batch_entry_t irqs[kDifUartIrqLast + 1];
+  for (dif_uart_irq_t irq = 0; irq <= kDifUartIrqLast; ++irq) {
+    irqs[irq] = (plic_batch_entry_t){
+        .irq = kTopAthosPlicIrqIdUart0TxWatermark + irq,
+        .priority = kDifPlicMaxPriority,
+        .trigger = kDifPlicIrqTriggerLevel,
+        .target = kPlicTarget,
+    };
+  }
+
+  // Set Ibex IRQ priority threshold level
+  CHECK(dif_plic_target_set_threshold(plic, kPlicTarget,
+                                      kDifPlicMinPriority) == kDifPlicOk,
+        "threshold set failed!");
+  CHECK(plic_batch_configure(plic, irqs, ARRAYSIZE(irqs)) == kDifPlicOk,
+        "PLIC IRQ configuration failed!");
+}
+
+/**
+ * Runs `kBurstRounds` bursts of `count` forced UART interrupts.
+ */
+static burst_result_t run_burst(plic_dispatch_mode_t mode, uint32_t count) {
+  plic_dispatch_set_mode(mode);
+  plic_dispatch_stats(true);
+
+  uint64_t cycles = 0;
+  for (uint32_t round = 0; round < kBurstRounds; ++round) {
+    irqs_handled = 0;
+
+    uint32_t irq_state = irq_lock_acquire();
+    for (uint32_t i = 0; i < count; ++i) {
+      CHECK(dif_uart_irq_force(&uart0, (dif_uart_irq_t)i) == kDifUartOk,
+            "failed to force UART IRQ %d!", i);
+    }
+    uint64_t start = ibex_mcycle_read();
+    irq_lock_release(irq_state);
+    while (irqs_handled < count) {
+    }
+    cycles += ibex_mcycle_read() - start;
+  }
+
+  plic_dispatch_stats_t stats = plic_dispatch_stats(false);
+  CHECK(stats.irqs == count * kBurstRounds, "serviced %d IRQs, expected %d",
+        stats.irqs, count * kBurstRounds);
+  return (burst_result_t){
+      .cycles = (uint32_t)(cycles / kBurstRounds),
+      .traps = stats.traps / kBurstRounds,
+  };
+}
+
+const test_config_t kTestConfig = {
+    .can_clobber_uart = true,
+};
+
+bool test_main(void) {
+  LOG_INFO("Running PLIC burst benchmark");
+
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
+            },
+            &uart0) == kDifUartOk);
+  CHECK(dif_plic_init(
+            (dif_plic_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR),
+            },
+            &plic0) == kDifPlicOk,
+        "PLIC init failed!");
+
+  plic_dispatch_init(&plic0, kPlicTarget);
+  plic_dispatch_register_range(kTopAthosPlicIrqIdUart0TxWatermark,
+                               kDifUartIrqLast + 1, handle_uart_isr, NULL);
+  plic_configure_irqs(&plic0);
+
+  // Enable IRQs on Ibex
+  irq_global_ctrl(true);
+  irq_external_ctrl(true);
+
+  // Wait for the console to go quiet, so that it does not raise interrupts of
+  // its own during the runs.
+  while (!mmio_region_get_bit32(uart0.params.base_addr, UART_STATUS_REG_OFFSET,
+                                UART_STATUS_TXIDLE_BIT)) {
+  }
+  uart_configure_irqs(&uart0, kDifUartToggleEnabled);
+
+  for (int s = 0; s < ARRAYSIZE(kBurstSizes); ++s) {
+    for (plic_dispatch_mode_t mode = 0; mode < ARRAYSIZE(kModeNames);
+         ++mode) {
+      results[s][mode] = run_burst(mode, kBurstSizes[s]);
+    }
+  }
+
+  uart_configure_irqs(&uart0, kDifUartToggleDisabled);
+  for (int s = 0; s < ARRAYSIZE(kBurstSizes); ++s) {
+    for (plic_dispatch_mode_t mode = 0; mode < ARRAYSIZE(kModeNames);
+         ++mode) {
+      LOG_INFO("BENCH plic_burst mode=%s irqs=%u cycles=%u traps=%u",
+               kModeNames[mode], kBurstSizes[s], results[s][mode].cycles,
+               results[s][mode].traps);
+    }
+  }
+
+  LOG_INFO("Completed Running PLIC burst benchmark");
+
+  return true;
+}
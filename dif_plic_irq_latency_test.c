@@ -0,0 +1,303 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_plic.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/dif_gpio.h"
+#include "dif/dif_uart.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "plic_batch.h"
+#include "plic_dispatch.h"
+#include "sample_stats.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+#include "uart_regs.h"                 // Generated.
+
+/**
+ * Interrupt latency test.
+ *
+ * Forces every UART0 and GPIO interrupt of the PLIC smoketests many times
+ * over, taking an `mcycle` timestamp right before the DIF force call and
+ * again on entry to `handler_irq_external()` and to the handler of the IRQ,
+ * and reports two latencies per source:
+ *
+ *   - entry: force to `handler_irq_external()`; the hardware path plus the
+ *     trap vector and its register save.
+ *   - handler: force to the registered handler; the above plus the PLIC claim
+ *     and the dispatch.
+ *
+ * as min/mean/p99/max in CPU cycles, with the cost of the timestamp read
+ * itself taken out.
+ */
+
+static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
+
+enum {
+  kSamples = 4096,
+  /**
+   * Samples per source in simulation; the full run takes too long there.
+   */
+  kSamplesSim = 64,
+  /**
+   * GPIO pins whose interrupts are measured.
+   */
+  kGpioPins = 2,
+};
+
+typedef enum latency_peripheral {
+  kLatencyPeripheralUart,
+  kLatencyPeripheralGpio,
+} latency_peripheral_t;
+
+/**
+ * An interrupt source under test.
+ */
+typedef struct latency_source {
+  const char *name;
+  latency_peripheral_t peripheral;
+  /**
+   * `dif_uart_irq_t`, or GPIO pin.
+   */
+  uint32_t irq;
+} latency_source_t;
+
+static const latency_source_t kSources[] = {
+    {"uart0_tx_watermark", kLatencyPeripheralUart, kDifUartIrqTxWatermark},
+    {"uart0_rx_watermark", kLatencyPeripheralUart, kDifUartIrqRxWatermark},
+    {"uart0_tx_empty", kLatencyPeripheralUart, kDifUartIrqTxEmpty},
+    {"uart0_rx_overflow", kLatencyPeripheralUart, kDifUartIrqRxOverflow},
+    {"uart0_rx_frame_err", kLatencyPeripheralUart, kDifUartIrqRxFrameErr},
+    {"uart0_rx_break_err", kLatencyPeripheralUart, kDifUartIrqRxBreakErr},
+    {"uart0_rx_timeout", kLatencyPeripheralUart, kDifUartIrqRxTimeout},
+    {"uart0_rx_parity_err", kLatencyPeripheralUart, kDifUartIrqRxParityErr},
+    {"gpio0", kLatencyPeripheralGpio, 0},
+    {"gpio1", kLatencyPeripheralGpio, 1},
+};
+
+typedef struct latency_result {
+  sample_stats_t entry;
+  sample_stats_t handler;
+} latency_result_t;
+
+/**
+ * Results are only logged once all sources are done, as the console output
+ * raises UART interrupts itself.
+ */
+static latency_result_t results[ARRAYSIZE(kSources)];
+
+static uint32_t entry_samples[kSamples];
+static uint32_t handler_samples[kSamples];
+
+static dif_plic_t plic0;
+static dif_uart_t uart0;
+static dif_gpio_t gpio;
+
+/**
+ * Low words of `mcycle` on entry to `handler_irq_external()` and to the IRQ
+ * handler of the last interrupt; the low word is enough for differences of
+ * less than 2^32 cycles.
+ */
+static volatile uint32_t entry_cycles;
+static volatile uint32_t handler_cycles;
+static volatile bool irq_taken;
+
+/**
+ * External interrupt handler
+ *
+ * Timestamps before anything else, then hands the interrupt to its handler.
+ */
+void handler_irq_external(void) {
+  entry_cycles = (uint32_t)ibex_mcycle_read();
+  plic_dispatch_handle();
+}
+
+static void handle_uart_isr(void *ctx, dif_plic_irq_id_t interrupt_id) {
+  handler_cycles = (uint32_t)ibex_mcycle_read();
+  // PLIC IRQ IDs of a UART instance are laid out in `dif_uart_irq_t` order.
+  dif_uart_irq_t uart_irq =
+      (dif_uart_irq_t)(interrupt_id - kTopAthosPlicIrqIdUart0TxWatermark);
+  CHECK(dif_uart_irq_acknowledge(&uart0, uart_irq) == kDifUartOk,
+        "ISR failed to clear IRQ!");
+  irq_taken = true;
+}
+
+static void handle_gpio_isr(void *ctx, dif_plic_irq_id_t interrupt_id) {
+  handler_cycles = (uint32_t)ibex_mcycle_read();
+  dif_gpio_pin_t pin = interrupt_id - kTopAthosPlicIrqIdGpioGpio0;
+  CHECK(dif_gpio_irq_acknowledge(&gpio, pin) == kDifGpioOk,
+        "ISR failed to clear IRQ!");
+  irq_taken = true;
+}
+
+static void uart_configure_irqs(dif_uart_t *uart, dif_uart_toggle_t state) {
+  for (dif_uart_irq_t irq = 0; irq <= kDifUartIrqLast; ++irq) {
+    CHECK(dif_uart_irq_set_enabled(uart, irq, state) == kDifUartOk,
+          "UART IRQ enable failed!");
+  }
+}
+
+static void gpio_configure_irqs(dif_gpio_t *gpio) {
+  for (dif_gpio_pin_t pin = 0; pin < kGpioPins; ++pin) {
+    CHECK(dif_gpio_irq_set_enabled(gpio, pin, kDifGpioToggleEnabled) ==
+              kDifGpioOk,
+          "gpio IRQ enable failed!");
+  }
+}
+
+static void plic_configure_irqs(dif_plic_t *plic) {
+  plic_batch_entry_t irqs[kDifUartIrqLast + 1 + kGpioPins];
+  size_t count = 0;
+  for (dif_uart_irq_t irq = 0; irq <= kDifUartIrqLast; ++irq) {
+    irqs[count++] = (plic_batch_entry_t){
+        .irq = kTopAthosPlicIrqIdUart0TxWatermark + irq,
+        .priority = kDifPlicMaxPriority,
+        .trigger = kDifPlicIrqTriggerLevel,
+        .target = kPlicTarget,
+    };
+  }
+  for (dif_gpio_pin_t pin = 0; pin < kGpioPins; ++pin) {
+    irqs[count++] = (plic_batch_entry_t){
+        .irq = kTopAthosPlicIrqIdGpioGpio0 + pin,
+        .priority = kDifPlicMaxPriority,
+        .trigger = kDifPlicIrqTriggerLevel,
+        .target = kPlicTarget,
+    };
+  }
+
+  // Set Ibex IRQ priority threshold level
+  CHECK(dif_plic_target_set_threshold(plic, kPlicTarget,
+                                      kDifPlicMinPriority) == kDifPlicOk,
+        "threshold set failed!");
+  CHECK(plic_batch_configure(plic, irqs, count) == kDifPlicOk,
+        "PLIC IRQ configuration failed!");
+}
+
+/**
+ * Returns the cycles that an `mcycle` timestamp pair adds to a measurement,
+ * i.e. the smallest difference between two back-to-back reads.
+ */
+static uint32_t timestamp_overhead(void) {
+  uint32_t overhead = UINT32_MAX;
+  for (int i = 0; i < 16; ++i) {
+    uint32_t start = (uint32_t)ibex_mcycle_read();
+    uint32_t cycles = (uint32_t)ibex_mcycle_read() - start;
+    if (cycles < overhead) {
+      overhead = cycles;
+    }
+  }
+  return overhead;
+}
+
+/**
+ * Forces `source` `count` times and summarises its latencies.
+ */
+static latency_result_t measure_source(const latency_source_t *source,
+                                       size_t count, uint32_t overhead) {
+  for (size_t i = 0; i < count; ++i) {
+    irq_taken = false;
+
+    uint32_t start;
+    if (source->peripheral == kLatencyPeripheralUart) {
+      start = (uint32_t)ibex_mcycle_read();
+      CHECK(dif_uart_irq_force(&uart0, (dif_uart_irq_t)source->irq) ==
+                kDifUartOk,
+            "failed to force %s IRQ!", source->name);
+    } else {
+      start = (uint32_t)ibex_mcycle_read();
+      CHECK(dif_gpio_irq_force(&gpio, source->irq) == kDifGpioOk,
+            "failed to force %s IRQ!", source->name);
+    }
+    while (!irq_taken) {
+    }
+
+    entry_samples[i] = entry_cycles - start - overhead;
+    handler_samples[i] = handler_cycles - start - overhead;
+  }
+
+  return (latency_result_t){
+      .entry = sample_stats_compute(entry_samples, count),
+      .handler = sample_stats_compute(handler_samples, count),
+  };
+}
+
+static void log_stats(const char *source, const char *stage,
+                      const sample_stats_t *stats) {
+  LOG_INFO("%s %s latency: samples=%u min=%u mean=%u p99=%u max=%u", source,
+           stage, stats->count, stats->min, stats->mean, stats->p99,
+           stats->max);
+}
+
+const test_config_t kTestConfig = {
+    .can_clobber_uart = true,
+};
+
+bool test_main(void) {
+  LOG_INFO("Running PLIC IRQ latency test");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+  size_t samples = is_sim ? kSamplesSim : kSamples;
+
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
+            },
+            &uart0) == kDifUartOk);
+  CHECK(dif_gpio_init(
+            (dif_gpio_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_GPIO_BASE_ADDR),
+            },
+            &gpio) == kDifGpioOk,
+        "gpio init failed!");
+  CHECK(dif_plic_init(
+            (dif_plic_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR),
+            },
+            &plic0) == kDifPlicOk,
+        "PLIC init failed!");
+
+  plic_dispatch_init(&plic0, kPlicTarget);
+  plic_dispatch_register_range(kTopAthosPlicIrqIdUart0TxWatermark,
+                               kDifUartIrqLast + 1, handle_uart_isr, NULL);
+  plic_dispatch_register_range(kTopAthosPlicIrqIdGpioGpio0, kGpioPins,
+                               handle_gpio_isr, NULL);
+  plic_configure_irqs(&plic0);
+  gpio_configure_irqs(&gpio);
+
+  uint32_t overhead = timestamp_overhead();
+
+  // Enable IRQs on Ibex
+  irq_global_ctrl(true);
+  irq_external_ctrl(true);
+
+  // Wait for the console to go quiet, so that it does not raise interrupts of
+  // its own during the runs.
+  while (!mmio_region_get_bit32(uart0.params.base_addr, UART_STATUS_REG_OFFSET,
+                                UART_STATUS_TXIDLE_BIT)) {
+  }
+  uart_configure_irqs(&uart0, kDifUartToggleEnabled);
+
+  for (int i = 0; i < ARRAYSIZE(kSources); ++i) {
+    results[i] = measure_source(&kSources[i], samples, overhead);
+  }
+
+  uart_configure_irqs(&uart0, kDifUartToggleDisabled);
+  LOG_INFO("timestamp overhead: %u cycles", overhead);
+  for (int i = 0; i < ARRAYSIZE(kSources); ++i) {
+    log_stats(kSources[i].name, "entry", &results[i].entry);
+    log_stats(kSources[i].name, "handler", &results[i].handler);
+  }
+
+  LOG_INFO("Completed Running PLIC IRQ latency test");
+
+  return true;
+}
@@ -0,0 +1,230 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_plic.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/dif_gpio.h"
+#include "dif/dif_uart.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "plic_batch.h"
+#include "plic_dispatch.h"
+#include "sample_stats.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * Nested interrupt test.
+ *
+ * A low priority UART interrupt handler forces a high priority GPIO interrupt
+ * and then stays busy for `kBusyCycles`. The latency of the GPIO interrupt,
+ * from the force to its handler, is measured both with the handlers run to
+ * completion one after another, where it includes the rest of the busy UART
+ * handler, and with preemptible handlers, where it must not.
+ */
+
+static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
+
+static const dif_plic_irq_id_t kLowIrq = kTopAthosPlicIrqIdUart0RxParityErr;
+static const dif_plic_irq_id_t kHighIrq = kTopAthosPlicIrqIdGpioGpio0;
+static const dif_gpio_pin_t kHighGpioPin = 0;
+
+enum {
+  kSamples = 256,
+  /**
+   * Samples per mode in simulation; the full run takes too long there.
+   */
+  kSamplesSim = 16,
+  /**
+   * Cycles the low priority handler stays busy for.
+   */
+  kBusyCycles = 20000,
+};
+
+static const char *const kModeNames[] = {
+    [kPlicDispatchModeSingle] = "run-to-completion",
+    [kPlicDispatchModeNested] = "nested",
+};
+
+static dif_plic_t plic0;
+static dif_uart_t uart0;
+static dif_gpio_t gpio;
+
+static uint32_t samples[kSamples];
+
+/**
+ * Low words of `mcycle` right before the GPIO interrupt is forced, and on
+ * entry to its handler.
+ */
+static volatile uint32_t force_cycles;
+static volatile uint32_t high_cycles;
+static volatile bool low_done;
+static volatile bool high_done;
+/**
+ * Whether the GPIO handler ran before the UART handler was done.
+ */
+static volatile bool high_preempted;
+
+/**
+ * External interrupt handler
+ */
+void handler_irq_external(void) { plic_dispatch_handle(); }
+
+/**
+ * Low priority UART interrupt handler; raises the high priority interrupt,
+ * then keeps busy.
+ */
+static void handle_uart_isr(void *ctx, dif_plic_irq_id_t interrupt_id) {
+  CHECK(dif_uart_irq_acknowledge(&uart0, kDifUartIrqRxParityErr) ==
+            kDifUartOk,
+        "ISR failed to clear IRQ!");
+
+  force_cycles = (uint32_t)ibex_mcycle_read();
+  CHECK(dif_gpio_irq_force(&gpio, kHighGpioPin) == kDifGpioOk,
+        "failed to force gpio IRQ!");
+  while ((uint32_t)ibex_mcycle_read() - force_cycles < kBusyCycles) {
+  }
+
+  low_done = true;
+}
+
+/**
+ * High priority GPIO interrupt handler.
+ */
+static void handle_gpio_isr(void *ctx, dif_plic_irq_id_t interrupt_id) {
+  high_cycles = (uint32_t)ibex_mcycle_read();
+  CHECK(dif_gpio_irq_acknowledge(&gpio, kHighGpioPin) == kDifGpioOk,
+        "ISR failed to clear IRQ!");
+  high_preempted = !low_done;
+  high_done = true;
+}
+
+static void plic_configure_irqs(dif_plic_t *plic) {
+  const plic_batch_entry_t irqs[] = {
+      {kLowIrq, kDifPlicMinPriority + 1, kDifPlicIrqTriggerLevel,
+       kPlicTarget},
+      {kHighIrq, kDifPlicMaxPriority, kDifPlicIrqTriggerLevel, kPlicTarget},
+  };
+
+  // Set Ibex IRQ priority threshold level
+  plic_dispatch_set_threshold(kDifPlicMinPriority);
+  CHECK(plic_batch_configure(plic, irqs, ARRAYSIZE(irqs)) == kDifPlicOk,
+        "PLIC IRQ configuration failed!");
+}
+
+/**
+ * Measures the GPIO interrupt latency `count` times in `mode`.
+ */
+static sample_stats_t run_mode(plic_dispatch_mode_t mode, size_t count) {
+  plic_dispatch_set_mode(mode);
+  plic_dispatch_stats(true);
+
+  uint32_t preempted = 0;
+  for (size_t i = 0; i < count; ++i) {
+    low_done = false;
+    high_done = false;
+    CHECK(dif_uart_irq_force(&uart0, kDifUartIrqRxParityErr) == kDifUartOk,
+          "failed to force UART IRQ!");
+    while (!low_done || !high_done) {
+    }
+    samples[i] = high_cycles - force_cycles;
+    preempted += high_preempted;
+  }
+
+  plic_dispatch_stats_t stats = plic_dispatch_stats(false);
+  CHECK(stats.irqs == 2 * count, "serviced %d IRQs, expected %d", stats.irqs,
+        2 * count);
+  if (mode == kPlicDispatchModeNested) {
+    CHECK(preempted == count && stats.max_depth == 2,
+          "%s: %d of %d handlers preempted, depth %d", kModeNames[mode],
+          preempted, count, stats.max_depth);
+  } else {
+    CHECK(preempted == 0 && stats.max_depth == 1,
+          "%s: %d of %d handlers preempted, depth %d", kModeNames[mode],
+          preempted, count, stats.max_depth);
+  }
+
+  return sample_stats_compute(samples, count);
+}
+
+const test_config_t kTestConfig;
+
+bool test_main(void) {
+  LOG_INFO("Running PLIC nested IRQ test");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+  size_t count = is_sim ? kSamplesSim : kSamples;
+
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
+            },
+            &uart0) == kDifUartOk);
+  CHECK(dif_gpio_init(
+            (dif_gpio_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_GPIO_BASE_ADDR),
+            },
+            &gpio) == kDifGpioOk,
+        "gpio init failed!");
+  CHECK(dif_plic_init(
+            (dif_plic_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR),
+            },
+            &plic0) == kDifPlicOk,
+        "PLIC init failed!");
+
+  plic_dispatch_init(&plic0, kPlicTarget);
+  plic_dispatch_register(kLowIrq, handle_uart_isr, NULL);
+  plic_dispatch_register(kHighIrq, handle_gpio_isr, NULL);
+  plic_configure_irqs(&plic0);
+
+  // Only the RX parity error interrupt is enabled on UART0, which the console
+  // output does not raise.
+  CHECK(dif_uart_irq_set_enabled(&uart0, kDifUartIrqRxParityErr,
+                                 kDifUartToggleEnabled) == kDifUartOk,
+        "RX parity error IRQ enable failed!");
+  CHECK(dif_gpio_irq_set_enabled(&gpio, kHighGpioPin, kDifGpioToggleEnabled) ==
+            kDifGpioOk,
+        "gpio IRQ enable failed!");
+
+  // Enable IRQs on Ibex
+  irq_global_ctrl(true);
+  irq_external_ctrl(true);
+
+  sample_stats_t run_to_completion = run_mode(kPlicDispatchModeSingle, count);
+  sample_stats_t nested = run_mode(kPlicDispatchModeNested, count);
+
+  plic_dispatch_set_mode(kPlicDispatchModeSingle);
+  CHECK(dif_uart_irq_set_enabled(&uart0, kDifUartIrqRxParityErr,
+                                 kDifUartToggleDisabled) == kDifUartOk,
+        "RX parity error IRQ disable failed!");
+
+  LOG_INFO("%s high priority latency: min=%u mean=%u p99=%u max=%u",
+           kModeNames[kPlicDispatchModeSingle], run_to_completion.min,
+           run_to_completion.mean, run_to_completion.p99,
+           run_to_completion.max);
+  LOG_INFO("%s high priority latency: min=%u mean=%u p99=%u max=%u",
+           kModeNames[kPlicDispatchModeNested], nested.min, nested.mean,
+           nested.p99, nested.max);
+
+  // Without preemption the GPIO handler waits for the whole busy loop; with
+  // it, it must not wait for any of it.
+  CHECK(run_to_completion.min >= kBusyCycles,
+        "run-to-completion latency %d below the busy time",
+        run_to_completion.min);
+  CHECK(nested.max < kBusyCycles, "nested latency %d not below the busy time",
+        nested.max);
+
+  LOG_INFO("Completed Running PLIC nested IRQ test");
+
+  return true;
+}
@@ -0,0 +1,276 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_plic.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/dif_gpio.h"
+#include "dif/dif_uart.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "irq_lock.h"
+#include "plic_batch.h"
+#include "plic_dispatch.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+#include "uart_regs.h"                 // Generated.
+
+/**
+ * PLIC sustained interrupt rate benchmark.
+ *
+ * Forces the UART0 and GPIO interrupts round robin, one every `interval`
+ * cycles, for decreasing intervals. A force is dropped and counted as missed
+ * when the previous interrupt of its source has not been handled yet, i.e.
+ * when the handler stack has fallen behind; the shortest interval without
+ * misses is the saturation point. Emits one result line per interval:
+ *
+ *   BENCH plic_rate interval=<u> forced=<u> missed=<u> irqs_per_sec=<u>
+ *         cycles_per_irq=<u> isr_cycles_per_irq=<u>
+ *
+ * (on a single line), where `cycles_per_irq` is the elapsed time per handled
+ * interrupt, and `isr_cycles_per_irq` the part of it spent in
+ * `handler_irq_external()`; the rest is the trap entry and exit, and the
+ * forcing loop.
+ */
+
+static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
+
+/**
+ * Cycles between two forced interrupts, from well below to beyond the
+ * saturation point; 0 forces back to back.
+ */
+static const uint32_t kIntervals[] = {4096, 2048, 1024, 512, 256,
+                                      128,  64,   32,   0};
+
+enum {
+  kForcesPerRun = 4096,
+  /**
+   * Forces per run in simulation; the full run takes too long there.
+   */
+  kForcesPerRunSim = 64,
+  kGpioPins = 2,
+  kSources = kDifUartIrqLast + 1 + kGpioPins,
+};
+
+typedef struct rate_result {
+  uint32_t forced;
+  uint32_t missed;
+  uint32_t cycles;
+  uint32_t isr_cycles;
+} rate_result_t;
+
+/**
+ * Results are only logged once all runs are done, as the console output
+ * raises UART interrupts itself.
+ */
+static rate_result_t results[ARRAYSIZE(kIntervals)];
+
+static dif_plic_t plic0;
+static dif_uart_t uart0;
+static dif_gpio_t gpio;
+
+/**
+ * Sources forced and not handled yet, one bit per source: the UART IRQs in
+ * `dif_uart_irq_t` order, then the GPIO pins.
+ */
+static volatile uint32_t outstanding;
+static volatile uint32_t isr_cycles;
+
+/**
+ * External interrupt handler
+ */
+void handler_irq_external(void) {
+  uint32_t start = (uint32_t)ibex_mcycle_read();
+  plic_dispatch_handle();
+  isr_cycles += (uint32_t)ibex_mcycle_read() - start;
+}
+
+static void handle_uart_isr(void *ctx, dif_plic_irq_id_t interrupt_id) {
+  // PLIC IRQ IDs of a UART instance are laid out in `dif_uart_irq_t` order.
+  dif_uart_irq_t uart_irq =
+      (dif_uart_irq_t)(interrupt_id - kTopAthosPlicIrqIdUart0TxWatermark);
+  CHECK(dif_uart_irq_acknowledge(&uart0, uart_irq) == kDifUartOk,
+        "ISR failed to clear IRQ!");
+  outstanding &= ~(1u << uart_irq);
+}
+
+static void handle_gpio_isr(void *ctx, dif_plic_irq_id_t interrupt_id) {
+  dif_gpio_pin_t pin = interrupt_id - kTopAthosPlicIrqIdGpioGpio0;
+  CHECK(dif_gpio_irq_acknowledge(&gpio, pin) == kDifGpioOk,
+        "ISR failed to clear IRQ!");
+  outstanding &= ~(1u << (kDifUartIrqLast + 1 + pin));
+}
+
+static void uart_configure_irqs(dif_uart_t *uart, dif_uart_toggle_t state) {
+  for (dif_uart_irq_t irq = 0; irq <= kDifUartIrqLast; ++irq) {
+    CHECK(dif_uart_irq_set_enabled(uart, irq, state) == kDifUartOk,
+          "UART IRQ enable failed!");
+  }
+}
+
+static void plic_configure_irqs(dif_plic_t *plic) {
+  plic_batch_entry_t irqs[kSources];
+  for (uint32_t source = 0; source < kSources; ++source) {
+    irqs[source] = (plic_batch_entry_t){
+        .irq = source <= kDifUartIrqLast
+                   ? kTopAthosPlicIrqIdUart0TxWatermark + source
+                   : kTopAthosPlicIrqIdGpioGpio0 + source -
+                         (kDifUartIrqLast + 1),
+        .priority = kDifPlicMaxPriority,
+        .trigger = kDifPlicIrqTriggerLevel,
+        .target = kPlicTarget,
+    };
+  }
+
+  // Set Ibex IRQ priority threshold level
+  CHECK(dif_plic_target_set_threshold(plic, kPlicTarget,
+                                      kDifPlicMinPriority) == kDifPlicOk,
+        "threshold set failed!");
+  CHECK(plic_batch_configure(plic, irqs, ARRAYSIZE(irqs)) == kDifPlicOk,
+        "PLIC IRQ configuration failed!");
+}
+
+static void source_force(uint32_t source) {
+  if (source <= kDifUartIrqLast) {
+    CHECK(dif_uart_irq_force(&uart0, (dif_uart_irq_t)source) == kDifUartOk,
+          "failed to force UART IRQ %d!", source);
+  } else {
+    CHECK(dif_gpio_irq_force(&gpio, source - (kDifUartIrqLast + 1)) ==
+              kDifGpioOk,
+          "failed to force gpio IRQ %d!", source);
+  }
+}
+
+/**
+ * Forces `count` interrupts, one every `interval` cycles.
+ */
+static rate_result_t run_rate(uint32_t interval, uint32_t count) {
+  uint32_t missed = 0;
+  uint32_t source = 0;
+  isr_cycles = 0;
+
+  uint32_t start = (uint32_t)ibex_mcycle_read();
+  uint32_t next = start;
+  for (uint32_t i = 0; i < count; ++i) {
+    while ((int32_t)((uint32_t)ibex_mcycle_read() - next) < 0) {
+    }
+    next += interval;
+
+    // A force of a source that is still pending would be merged with it.
+    uint32_t bit = 1u << source;
+    if ((outstanding & bit) != 0) {
+      ++missed;
+    } else {
+      // The handlers clear bits from the same word.
+      uint32_t irq_state = irq_lock_acquire();
+      outstanding |= bit;
+      irq_lock_release(irq_state);
+      source_force(source);
+    }
+    source = source + 1 < kSources ? source + 1 : 0;
+  }
+  while (outstanding != 0) {
+  }
+  uint32_t cycles = (uint32_t)ibex_mcycle_read() - start;
+
+  return (rate_result_t){
+      .forced = count,
+      .missed = missed,
+      .cycles = cycles,
+      .isr_cycles = isr_cycles,
+  };
+}
+
+const test_config_t kTestConfig = {
+    .can_clobber_uart = true,
+};
+
+bool test_main(void) {
+  LOG_INFO("Running PLIC rate benchmark");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+  uint32_t count = is_sim ? kForcesPerRunSim : kForcesPerRun;
+
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
+            },
+            &uart0) == kDifUartOk);
+  CHECK(dif_gpio_init(
+            (dif_gpio_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_GPIO_BASE_ADDR),
+            },
+            &gpio) == kDifGpioOk,
+        "gpio init failed!");
+  CHECK(dif_plic_init(
+            (dif_plic_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR),
+            },
+            &plic0) == kDifPlicOk,
+        "PLIC init failed!");
+
+  plic_dispatch_init(&plic0, kPlicTarget);
+  plic_dispatch_register_range(kTopAthosPlicIrqIdUart0TxWatermark,
+                               kDifUartIrqLast + 1, handle_uart_isr, NULL);
+  plic_dispatch_register_range(kTopAthosPlicIrqIdGpioGpio0, kGpioPins,
+                               handle_gpio_isr, NULL);
+  plic_configure_irqs(&plic0);
+  for (dif_gpio_pin_t pin = 0; pin < kGpioPins; ++pin) {
+    CHECK(dif_gpio_irq_set_enabled(&gpio, pin, kDifGpioToggleEnabled) ==
+              kDifGpioOk,
+          "gpio IRQ enable failed!");
+  }
+
+  // Enable IRQs on Ibex
+  irq_global_ctrl(true);
+  irq_external_ctrl(true);
+
+  // Wait for the console to go quiet, so that it does not raise interrupts of
+  // its own during the runs.
+  while (!mmio_region_get_bit32(uart0.params.base_addr, UART_STATUS_REG_OFFSET,
+                                UART_STATUS_TXIDLE_BIT)) {
+  }
+  uart_configure_irqs(&uart0, kDifUartToggleEnabled);
+
+  for (int i = 0; i < ARRAYSIZE(kIntervals); ++i) {
+    results[i] = run_rate(kIntervals[i], count);
+  }
+
+  uart_configure_irqs(&uart0, kDifUartToggleDisabled);
+  int saturation = -1;
+  uint32_t saturation_rate = 0;
+  for (int i = 0; i < ARRAYSIZE(kIntervals); ++i) {
+    const rate_result_t *result = &results[i];
+    uint32_t handled = result->forced - result->missed;
+    uint32_t irqs_per_sec =
+        (uint32_t)((uint64_t)handled * kClockFreqCpuHz / result->cycles);
+    LOG_INFO(
+        "BENCH plic_rate interval=%u forced=%u missed=%u irqs_per_sec=%u "
+        "cycles_per_irq=%u isr_cycles_per_irq=%u",
+        kIntervals[i], result->forced, result->missed, irqs_per_sec,
+        result->cycles / handled, result->isr_cycles / handled);
+    // The shortest interval before the first one with misses.
+    if (result->missed == 0 && saturation == i - 1) {
+      saturation = i;
+      saturation_rate = irqs_per_sec;
+    }
+  }
+  if (saturation < 0) {
+    LOG_INFO("saturated at every interval");
+  } else {
+    LOG_INFO("saturation point: interval=%u, %u IRQs/s", kIntervals[saturation],
+             saturation_rate);
+  }
+
+  LOG_INFO("Completed Running PLIC rate benchmark");
+
+  return true;
+}
@@ -14,13 +14,23 @@
 #include "dif/hart.h"
 #include "dif/log.h"
 #include "dif/check.h"
+#include "dif/dif_rv_timer.h"
 #include "dif/test_main.h"
 #include "dif/test_status.h"
+#include "irq_await.h"
 
 #include "top/sw/autogen/top_athos.h"  // Generated.
 
 static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
 
+// The rv_timer comparator that bounds the wait for each forced IRQ.
+static const uint32_t kHart = (uint32_t)kTopAthosPlicTargetIbex0;
+static const uint32_t kComparator = 0;
+
+// Upper bound for a forced IRQ to be handled; the wait ends as soon as it is.
+static const uint32_t kIrqTimeoutUsec = 1000;
+
+static dif_rv_timer_t timer;
 static dif_plic_t plic0;
 static dif_uart_t uart0;
 
@@ -109,6 +119,21 @@ static void uart_initialise(mmio_region_t base_addr, dif_uart_t *uart) {
         "UART config failed!");
 }
 
+/**
+ * Timer interrupt handler
+ *
+ * Only the IRQ wait timeout is armed on the timer.
+ */
+void handler_irq_timer(void) { irq_await_handle_timer_irq(); }
+
+static void timer_initialise(mmio_region_t base_addr, dif_rv_timer_t *timer) {
+  CHECK(dif_rv_timer_init(
+            base_addr,
+            (dif_rv_timer_config_t){.hart_count = 1, .comparator_count = 1},
+            timer) == kDifRvTimerOk);
+  irq_await_init(timer, kHart, kComparator);
+}
+
 static void plic_initialise(mmio_region_t base_addr, dif_plic_t *plic) {
   CHECK(dif_plic_init((dif_plic_params_t){.base_addr = base_addr}, plic) ==
             kDifPlicOk,
@@ -170,21 +195,17 @@ static void execute_test(dif_uart_t *uart) {
   uart_rx_overflow_handled = false;
   CHECK(dif_uart_irq_force(uart, kDifUartIrqRxOverflow) == kDifUartOk,
         "failed to force RX overflow IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!uart_rx_overflow_handled) {
-    usleep(10);
-  }
-  CHECK(uart_rx_overflow_handled, "RX overflow IRQ has not been handled!");
+  // Wait for the IRQ to be handled.
+  CHECK(irq_await_flag(&uart_rx_overflow_handled, kIrqTimeoutUsec, NULL),
+        "RX overflow IRQ has not been handled!");
 
   // Force UART TX empty interrupt.
   uart_tx_empty_handled = false;
   CHECK(dif_uart_irq_force(uart, kDifUartIrqTxEmpty) == kDifUartOk,
         "failed to force TX empty IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!uart_tx_empty_handled) {
-    usleep(10);
-  }
-  CHECK(uart_tx_empty_handled, "TX empty IRQ has not been handled!");
+  // Wait for the IRQ to be handled.
+  CHECK(irq_await_flag(&uart_tx_empty_handled, kIrqTimeoutUsec, NULL),
+        "TX empty IRQ has not been handled!");
 }
 
 const test_config_t kTestConfig = {
@@ -205,6 +226,10 @@ bool test_main(void) {
       mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR);
   plic_initialise(plic_base_addr, &plic0);
 
+  mmio_region_t timer_base_addr =
+      mmio_region_from_addr(TOP_ATHOS_RV_TIMER_BASE_ADDR);
+  timer_initialise(timer_base_addr, &timer);
+
   uart_configure_irqs(&uart0);
   plic_configure_irqs(&plic0);
   execute_test(&uart0);
@@ -7,6 +7,7 @@
 
 #include "dif/dif_plic.h"
 
+#include "base/memory.h"
 #include "base/mmio.h"
 #include "dif/dif_gpio.h"
 #include "dif/handler.h"
@@ -14,13 +15,24 @@
 #include "dif/hart.h"
 #include "dif/log.h"
 #include "dif/check.h"
+#include "dif/dif_rv_timer.h"
 #include "dif/test_main.h"
-#include "dif/test_status.h"
+#include "irq_await.h"
+#include "plic_batch.h"
+#include "plic_dispatch.h"
 
 #include "top/sw/autogen/top_athos.h"  // Generated.
 
 static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
 
+// The rv_timer comparator that bounds the wait for each forced IRQ.
+static const uint32_t kHart = (uint32_t)kTopAthosPlicTargetIbex0;
+static const uint32_t kComparator = 0;
+
+// Upper bound for a forced IRQ to be handled; the wait ends as soon as it is.
+static const uint32_t kIrqTimeoutUsec = 1000;
+
+static dif_rv_timer_t timer;
 static dif_plic_t plic0;
 static dif_gpio_t gpio;
 
@@ -31,38 +43,35 @@ static dif_gpio_t gpio;
 static volatile bool gpio_gpio0;
 static volatile bool gpio_gpio1;
 
+/**
+ * A GPIO interrupt of the test; the context of its handler.
+ */
+typedef struct gpio_irq_ctx {
+  dif_gpio_irq_trigger_t gpio_irq;
+  volatile bool *handled;
+} gpio_irq_ctx_t;
+
+static const gpio_irq_ctx_t kGpio1Ctx = {
+    .gpio_irq = kDifGpioIrqTriggerEdgeFalling,
+    .handled = &gpio_gpio1,
+};
+static const gpio_irq_ctx_t kGpio0Ctx = {
+    .gpio_irq = kDifGpioIrqTriggerEdgeRising,
+    .handled = &gpio_gpio0,
+};
+
 /**
  * GPIO interrupt handler
  *
- * Services gpio interrupts, sets the appropriate flags that are used to
+ * Services a gpio interrupt, sets the flag of its context that is used to
  * determine success or failure of the test.
  */
-static void handle_gpio_isr(const dif_plic_irq_id_t interrupt_id) {
-  // NOTE: This initialization is superfluous, since the `default` case below
-  // is effectively noreturn, but the compiler is unable to prove this.
-  dif_gpio_irq_trigger_t gpio_irq = 0;
-
-  switch (interrupt_id) {    
-    case kTopAthosPlicIrqIdGpioGpio1:
-      CHECK(!gpio_gpio1,
-            "gpio gpio1 input for falling edge detection IRQ asserted more than once");
-
-      gpio_irq = kDifGpioIrqTriggerEdgeFalling;
-      gpio_gpio1 = true;
-      break;
-      case kTopAthosPlicIrqIdGpioGpio0:
-      CHECK(!gpio_gpio0,
-            "gpio gpio0 input for rising edge detection IRQ asserted more than once");
-
-      gpio_irq = kDifGpioIrqTriggerEdgeRising;
-      gpio_gpio0 = true;
-      break;
-    default:
-      LOG_FATAL("ISR is not implemented!");
-      test_status_set(kTestStatusFailed);
-  }
-
-  CHECK(dif_gpio_irq_acknowledge(&gpio, gpio_irq) == kDifGpioOk,
+static void handle_gpio_isr(void *ctx, dif_plic_irq_id_t interrupt_id) {
+  const gpio_irq_ctx_t *irq = ctx;
+  CHECK(!*irq->handled, "gpio IRQ %d asserted more than once", interrupt_id);
+  *irq->handled = true;
+
+  CHECK(dif_gpio_irq_acknowledge(&gpio, irq->gpio_irq) == kDifGpioOk,
         "ISR failed to clear IRQ!");
 }
 
@@ -73,24 +82,20 @@ static void handle_gpio_isr(const dif_plic_irq_id_t interrupt_id) {
  * line to the CPU, which results in a call to this handler. This handler
  * overrides the default implementation, and prototype for this handler must
  * include appropriate attributes.
+ *
+ * The handler of each IRQ is looked up in the dispatch table.
  */
-void handler_irq_external(void) {
-  // Claim the IRQ by reading the Ibex specific CC register.
-  dif_plic_irq_id_t interrupt_id;
-  CHECK(dif_plic_irq_claim(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
-        "ISR is not implemented!");
-
-  // Check if the interrupted peripheral is gpio.
-  top_athos_plic_peripheral_t peripheral_id =
-      top_athos_plic_interrupt_for_peripheral[interrupt_id];
-  CHECK(peripheral_id == kTopAthosPlicPeripheralGpio,
-        "ISR interrupted peripheral is not gpio!");
-  handle_gpio_isr(interrupt_id);
-
-  // Complete the IRQ by writing the IRQ source to the Ibex specific CC
-  // register.
-  CHECK(dif_plic_irq_complete(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
-        "Unable to complete the IRQ request!");
+void handler_irq_external(void) { plic_dispatch_handle(); }
+
+/**
+ * Registers the handler of every gpio interrupt.
+ */
+static void plic_register_irqs(void) {
+  plic_dispatch_init(&plic0, kPlicTarget);
+  plic_dispatch_register(kTopAthosPlicIrqIdGpioGpio1, handle_gpio_isr,
+                         (void *)&kGpio1Ctx);
+  plic_dispatch_register(kTopAthosPlicIrqIdGpioGpio0, handle_gpio_isr,
+                         (void *)&kGpio0Ctx);
 }
 
 static void gpio_initialise(mmio_region_t base_addr, dif_gpio_t *gpio) {
@@ -100,6 +105,21 @@ static void gpio_initialise(mmio_region_t base_addr, dif_gpio_t *gpio) {
             kDifGpioOk,"gpio init failed!");
 }
 
+/**
+ * Timer interrupt handler
+ *
+ * Only the IRQ wait timeout is armed on the timer.
+ */
+void handler_irq_timer(void) { irq_await_handle_timer_irq(); }
+
+static void timer_initialise(mmio_region_t base_addr, dif_rv_timer_t *timer) {
+  CHECK(dif_rv_timer_init(
+            base_addr,
+            (dif_rv_timer_config_t){.hart_count = 1, .comparator_count = 1},
+            timer) == kDifRvTimerOk);
+  irq_await_init(timer, kHart, kComparator);
+}
+
 static void plic_initialise(mmio_region_t base_addr, dif_plic_t *plic) {
   CHECK(dif_plic_init((dif_plic_params_t){.base_addr = base_addr}, plic) ==
             kDifPlicOk,
@@ -127,38 +147,22 @@ static void gpio_configure_irqs(dif_gpio_t *gpio) {
  * Configures all the relevant interrupts in PLIC.
  */
 static void plic_configure_irqs(dif_plic_t *plic) {
-  // Set IRQ triggers to be level triggered
-  CHECK(dif_plic_irq_set_trigger(plic, kTopAthosPlicIrqIdGpioGpio1,
-                                 kDifPlicIrqTriggerLevel) == kDifPlicOk,
-        "Falling edge trigger type set failed!");
-  CHECK(dif_plic_irq_set_trigger(plic, kTopAthosPlicIrqIdGpioGpio0,
-                                 kDifPlicIrqTriggerLevel) == kDifPlicOk,
-        "Rising edge trigger type set failed!");
-
-  // Set IRQ priorities to MAX
-  CHECK(dif_plic_irq_set_priority(plic, kTopAthosPlicIrqIdGpioGpio1,
-                                  kDifPlicMaxPriority) == kDifPlicOk,
-        "priority set for Falling edge trigger failed!");
-
-  CHECK(dif_plic_irq_set_priority(plic, kTopAthosPlicIrqIdGpioGpio0,
-                                  kDifPlicMaxPriority) == kDifPlicOk,
-        "priority set for Rising edge trigger failed!");
+  const plic_batch_entry_t irqs[] = {
+      {kTopAthosPlicIrqIdGpioGpio1, kDifPlicMaxPriority,
+       kDifPlicIrqTriggerLevel, kPlicTarget},
+      {kTopAthosPlicIrqIdGpioGpio0, kDifPlicMaxPriority,
+       kDifPlicIrqTriggerLevel, kPlicTarget},
+  };
 
   // Set Ibex IRQ priority threshold level
   CHECK(dif_plic_target_set_threshold(&plic0, kPlicTarget,
                                       kDifPlicMinPriority) == kDifPlicOk,
         "threshold set failed!");
 
-  // Enable IRQs in PLIC
-  CHECK(dif_plic_irq_set_enabled(plic, kTopAthosPlicIrqIdGpioGpio1,
-                                 kPlicTarget,
-                                 kDifPlicToggleEnabled) == kDifPlicOk,
-        "interrupt Enable for Falling edge trigger failed!");
-
-  CHECK(dif_plic_irq_set_enabled(plic, kTopAthosPlicIrqIdGpioGpio0,
-                                 kPlicTarget,
-                                 kDifPlicToggleEnabled) == kDifPlicOk,
-        "interrupt Enable for Rising edge trigger failed!");
+  // Set IRQ triggers to be level triggered, IRQ priorities to MAX, and enable
+  // IRQs in PLIC.
+  CHECK(plic_batch_configure(plic, irqs, ARRAYSIZE(irqs)) == kDifPlicOk,
+        "PLIC IRQ configuration failed!");
 }
 
 static void execute_test(dif_gpio_t *gpio) {
@@ -166,21 +170,17 @@ static void execute_test(dif_gpio_t *gpio) {
   gpio_gpio1 = false;
   CHECK(dif_gpio_irq_force(gpio, kDifGpioIrqTriggerEdgeFalling) == kDifGpioOk,
         "failed to force Falling edge IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!gpio_gpio1) {
-    usleep(10);
-  }
-  CHECK(gpio_gpio1, "Falling edge IRQ has not been handled!");
+  // Wait for the IRQ to be handled.
+  CHECK(irq_await_flag(&gpio_gpio1, kIrqTimeoutUsec, NULL),
+        "Falling edge IRQ has not been handled!");
 
   // Force gpio Rising edge trigger interrupt.
   gpio_gpio0 = false;
   CHECK(dif_gpio_irq_force(gpio, kDifGpioIrqTriggerEdgeRising) == kDifGpioOk,
         "failed to force Rising edge IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!gpio_gpio0) {
-    usleep(10);
-  }
-  CHECK(gpio_gpio0, "Rising edge IRQ has not been handled!");
+  // Wait for the IRQ to be handled.
+  CHECK(irq_await_flag(&gpio_gpio0, kIrqTimeoutUsec, NULL),
+        "Rising edge IRQ has not been handled!");
 }
 
 const test_config_t kTestConfig;
@@ -199,6 +199,11 @@ bool test_main(void) {
       mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR);
   plic_initialise(plic_base_addr, &plic0);
 
+  mmio_region_t timer_base_addr =
+      mmio_region_from_addr(TOP_ATHOS_RV_TIMER_BASE_ADDR);
+  timer_initialise(timer_base_addr, &timer);
+
+  plic_register_irqs();
   gpio_configure_irqs(&gpio);
   plic_configure_irqs(&plic0);
   execute_test(&gpio);
@@ -7,6 +7,7 @@
 
 #include "dif/dif_plic.h"
 
+#include "base/memory.h"
 #include "base/mmio.h"
 #include "dif/dif_uart.h"
 #include "dif/handler.h"
@@ -14,108 +15,49 @@
 #include "dif/hart.h"
 #include "dif/log.h"
 #include "dif/check.h"
+#include "dif/dif_rv_timer.h"
 #include "dif/test_main.h"
-#include "dif/test_status.h"
+#include "irq_await.h"
+#include "irq_completion.h"
+#include "plic_batch.h"
+#include "plic_dispatch.h"
 
 #include "top/sw/autogen/top_athos.h"  // Generated.
 
 static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
 
+// The rv_timer comparator that bounds the wait for the forced IRQs.
+static const uint32_t kHart = (uint32_t)kTopAthosPlicTargetIbex0;
+static const uint32_t kComparator = 0;
+
+// Upper bound for the forced IRQs to be handled; the wait ends as soon as they
+// are.
+static const uint32_t kIrqTimeoutUsec = 1000;
+
+static dif_rv_timer_t timer;
 static dif_plic_t plic0;
 static dif_uart_t uart0;
 
-// These flags are used in the test routine to verify that a corresponding
-// interrupt has elapsed, and has been serviced. These are declared as volatile
-// since they are referenced in the ISR routine as well as in the main program
-// flow.
-static volatile bool uart_rx_overflow_handled;
-static volatile bool uart_tx_empty_handled;
-//edited
-static volatile bool uart_rx_frame_err_handled;
-static volatile bool uart_tx_watermark_handled;
-static volatile bool uart_rx_watermark_handled;
-static volatile bool uart_rx_break_err_handled;
-static volatile bool uart_rx_timeout_handled;
-static volatile bool uart_rx_parity_err_handled;
-//edited
+// Completion set of the UART interrupts, indexed by `dif_uart_irq_t`; used in
+// the test routine to verify that every forced interrupt has elapsed, and has
+// been serviced.
+static irq_completion_t uart_irqs_handled;
+
+// Every UART interrupt.
+static const uint32_t kUartIrqsAll = (1u << (kDifUartIrqLast + 1)) - 1;
 
 /**
  * UART interrupt handler
  *
- * Services UART interrupts, sets the appropriate flags that are used to
- * determine success or failure of the test.
+ * Services a UART interrupt, and marks it in the completion set, passed as
+ * `ctx`, that is used to determine success or failure of the test.
  */
-static void handle_uart_isr(const dif_plic_irq_id_t interrupt_id) {
-  // NOTE: This initialization is superfluous, since the `default` case below
-  // is effectively noreturn, but the compiler is unable to prove this.
-  dif_uart_irq_t uart_irq = 0;
-
-  switch (interrupt_id) {
-    //edited
-    case kTopAthosPlicIrqIdUart0RxParityErr:
-      CHECK(!uart_rx_parity_err_handled,
-            "UART rx_parity_err IRQ asserted more than once");
-
-      uart_irq = kDifUartIrqRxParityErr;
-      uart_rx_parity_err_handled = true;
-      break;
-    case kTopAthosPlicIrqIdUart0RxTimeout:
-      CHECK(!uart_rx_timeout_handled,
-            "UART rx_timeout IRQ asserted more than once");
-
-      uart_irq = kDifUartIrqRxTimeout;
-      uart_rx_timeout_handled = true;
-      break;
-    case kTopAthosPlicIrqIdUart0RxBreakErr:
-      CHECK(!uart_rx_break_err_handled,
-            "UART rx_break_err IRQ asserted more than once");
-
-      uart_irq = kDifUartIrqRxBreakErr;
-      uart_rx_break_err_handled = true;
-      break;
-    case kTopAthosPlicIrqIdUart0RxFrameErr:
-      CHECK(!uart_rx_frame_err_handled,
-            "UART RX framing error IRQ asserted more than once");
-
-      uart_irq = kDifUartIrqRxFrameErr;
-      uart_rx_frame_err_handled = true;
-    //edited
-      break;
-    case kTopAthosPlicIrqIdUart0RxOverflow:
-      CHECK(!uart_rx_overflow_handled,
-            "UART RX overflow IRQ asserted more than once");
-
-      uart_irq = kDifUartIrqRxOverflow;
-      uart_rx_overflow_handled = true;
-      break;
-    case kTopAthosPlicIrqIdUart0TxEmpty:
-      CHECK(!uart_tx_empty_handled,
-            "UART TX empty IRQ asserted more than once");
-
-      uart_irq = kDifUartIrqTxEmpty;
-      uart_tx_empty_handled = true;
-      break;
-    //edited
-    case kTopAthosPlicIrqIdUart0RxWatermark:
-      CHECK(!uart_rx_watermark_handled,
-            "UART rx_watermark IRQ asserted more than once");
-
-      uart_irq = kDifUartIrqRxWatermark;
-      uart_rx_watermark_handled = true;
-      break;
-    case kTopAthosPlicIrqIdUart0TxWatermark:
-      CHECK(!uart_tx_watermark_handled,
-            "UART tx_watermark IRQ asserted more than once");
-
-      uart_irq = kDifUartIrqTxWatermark;
-      uart_tx_watermark_handled = true;
-      break;
-    //edited
-     
-    default:
-      LOG_FATAL("ISR is not implemented!");
-      test_status_set(kTestStatusFailed);
-  }
+static void handle_uart_isr(void *ctx, dif_plic_irq_id_t interrupt_id) {
+  // PLIC IRQ IDs of a UART instance are laid out in `dif_uart_irq_t` order.
+  dif_uart_irq_t uart_irq =
+      (dif_uart_irq_t)(interrupt_id - kTopAthosPlicIrqIdUart0TxWatermark);
+  CHECK(!irq_completion_set(ctx, uart_irq),
+        "UART IRQ %d asserted more than once", interrupt_id);
 
   CHECK(dif_uart_irq_acknowledge(&uart0, uart_irq) == kDifUartOk,
         "ISR failed to clear IRQ!");
@@ -128,24 +70,20 @@ static void handle_uart_isr(const dif_plic_irq_id_t interrupt_id) {
  * line to the CPU, which results in a call to this handler. This handler
  * overrides the default implementation, and prototype for this handler must
  * include appropriate attributes.
+ *
+ * The handler of each IRQ is looked up in the dispatch table.
  */
-void handler_irq_external(void) {
-  // Claim the IRQ by reading the Ibex specific CC register.
-  dif_plic_irq_id_t interrupt_id;
-  CHECK(dif_plic_irq_claim(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
-        "ISR is not implemented!");
-
-  // Check if the interrupted peripheral is UART.
-  top_athos_plic_peripheral_t peripheral_id =
-      top_athos_plic_interrupt_for_peripheral[interrupt_id];
-  CHECK(peripheral_id == kTopAthosPlicPeripheralUart0,
-        "ISR interrupted peripheral is not UART!");
-  handle_uart_isr(interrupt_id);
-
-  // Complete the IRQ by writing the IRQ source to the Ibex specific CC
-  // register.
-  CHECK(dif_plic_irq_complete(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
-        "Unable to complete the IRQ request!");
+void handler_irq_external(void) { plic_dispatch_handle(); }
+
+/**
+ * Registers the handler of every UART interrupt, with the completion set as
+ * context.
+ */
+static void plic_register_irqs(void) {
+  plic_dispatch_init(&plic0, kPlicTarget);
+  plic_dispatch_register_range(kTopAthosPlicIrqIdUart0TxWatermark,
+                               kDifUartIrqLast + 1, handle_uart_isr,
+                               &uart_irqs_handled);
 }
 
 static void uart_initialise(mmio_region_t base_addr, dif_uart_t *uart) {
@@ -164,6 +102,21 @@ static void uart_initialise(mmio_region_t base_addr, dif_uart_t *uart) {
         "UART config failed!");
 }
 
+/**
+ * Timer interrupt handler
+ *
+ * Only the IRQ wait timeout is armed on the timer.
+ */
+void handler_irq_timer(void) { irq_await_handle_timer_irq(); }
+
+static void timer_initialise(mmio_region_t base_addr, dif_rv_timer_t *timer) {
+  CHECK(dif_rv_timer_init(
+            base_addr,
+            (dif_rv_timer_config_t){.hart_count = 1, .comparator_count = 1},
+            timer) == kDifRvTimerOk);
+  irq_await_init(timer, kHart, kComparator);
+}
+
 static void plic_initialise(mmio_region_t base_addr, dif_plic_t *plic) {
   CHECK(dif_plic_init((dif_plic_params_t){.base_addr = base_addr}, plic) ==
             kDifPlicOk,
@@ -210,200 +163,50 @@ static void uart_configure_irqs(dif_uart_t *uart) {
  * Configures all the relevant interrupts in PLIC.
  */
 static void plic_configure_irqs(dif_plic_t *plic) {
-  // Set IRQ triggers to be level triggered
-  // //edited-----------------------------------
-  CHECK(dif_plic_irq_set_trigger(plic, kTopAthosPlicIrqIdUart0RxParityErr,
-                                 kDifPlicIrqTriggerLevel) == kDifPlicOk,
-        "RX parity error trigger type set failed!");
-  CHECK(dif_plic_irq_set_trigger(plic, kTopAthosPlicIrqIdUart0RxTimeout,
-                                 kDifPlicIrqTriggerLevel) == kDifPlicOk,
-        "RX FIFO timeout expires before it is emptied trigger type set failed!");
-  CHECK(dif_plic_irq_set_trigger(plic, kTopAthosPlicIrqIdUart0RxBreakErr,
-                                 kDifPlicIrqTriggerLevel) == kDifPlicOk,
-        "RX break condition trigger type set failed!");
-  CHECK(dif_plic_irq_set_trigger(plic, kTopAthosPlicIrqIdUart0RxFrameErr,
-                                 kDifPlicIrqTriggerLevel) == kDifPlicOk,
-        "RX framing error trigger type set failed!");
-  //edited--------------------------------------
-  CHECK(dif_plic_irq_set_trigger(plic, kTopAthosPlicIrqIdUart0RxOverflow,
-                                 kDifPlicIrqTriggerLevel) == kDifPlicOk,
-        "RX overflow trigger type set failed!");
-  CHECK(dif_plic_irq_set_trigger(plic, kTopAthosPlicIrqIdUart0TxEmpty,
-                                 kDifPlicIrqTriggerLevel) == kDifPlicOk,
-        "TX empty trigger type set failed!");
-
-  //edited--------------------------------------
-  CHECK(dif_plic_irq_set_trigger(plic, kTopAthosPlicIrqIdUart0RxWatermark,
-                                 kDifPlicIrqTriggerLevel) == kDifPlicOk,
-        "RX FIFO goes over its watermark trigger type set failed!");
-  CHECK(dif_plic_irq_set_trigger(plic, kTopAthosPlicIrqIdUart0TxWatermark,
-                                 kDifPlicIrqTriggerLevel) == kDifPlicOk,
-        "TX FIFO dips below its watermark trigger type set failed!");
-  //edited--------------------------------------
-  
-
-  // Set IRQ priorities to MAX
-  //edited-----------------------------------
-  CHECK(dif_plic_irq_set_priority(plic, kTopAthosPlicIrqIdUart0RxParityErr,
-                                  kDifPlicMaxPriority) == kDifPlicOk,
-        "priority set for RX parity error failed!");
-  CHECK(dif_plic_irq_set_priority(plic, kTopAthosPlicIrqIdUart0RxTimeout,
-                                  kDifPlicMaxPriority) == kDifPlicOk,
-        "priority set for RX FIFO timeout expires before it is emptied failed!");
-  CHECK(dif_plic_irq_set_priority(plic, kTopAthosPlicIrqIdUart0RxBreakErr,
-                                  kDifPlicMaxPriority) == kDifPlicOk,
-        "priority set for RX break condition failed!");
-  CHECK(dif_plic_irq_set_priority(plic, kTopAthosPlicIrqIdUart0RxFrameErr,
-                                  kDifPlicMaxPriority) == kDifPlicOk,
-        "priority set for RX framing error failed!");
-  //edited--------------------------------------
-  CHECK(dif_plic_irq_set_priority(plic, kTopAthosPlicIrqIdUart0RxOverflow,
-                                  kDifPlicMaxPriority) == kDifPlicOk,
-        "priority set for RX overflow failed!");
-
-  CHECK(dif_plic_irq_set_priority(plic, kTopAthosPlicIrqIdUart0TxEmpty,
-                                  kDifPlicMaxPriority) == kDifPlicOk,
-        "priority set for TX empty failed!");
-  //edited--------------------------------------
-  CHECK(dif_plic_irq_set_priority(plic, kTopAthosPlicIrqIdUart0RxWatermark,
-                                  kDifPlicMaxPriority) == kDifPlicOk,
-        "priority set for RX FIFO goes over its watermark failed!");
-  CHECK(dif_plic_irq_set_priority(plic, kTopAthosPlicIrqIdUart0TxWatermark,
-                                  kDifPlicMaxPriority) == kDifPlicOk,
-        "priority set for TX FIFO dips below its watermark failed!");
-  //edited--------------------------------------
-  
+  const plic_batch_entry_t irqs[] = {
+      {kTopAthosPlicIrqIdUart0RxParityErr, kDifPlicMaxPriority,
+       kDifPlicIrqTriggerLevel, kPlicTarget},
+      {kTopAthosPlicIrqIdUart0RxTimeout, kDifPlicMaxPriority,
+       kDifPlicIrqTriggerLevel, kPlicTarget},
+      {kTopAthosPlicIrqIdUart0RxBreakErr, kDifPlicMaxPriority,
+       kDifPlicIrqTriggerLevel, kPlicTarget},
+      {kTopAthosPlicIrqIdUart0RxFrameErr, kDifPlicMaxPriority,
+       kDifPlicIrqTriggerLevel, kPlicTarget},
+      {kTopAthosPlicIrqIdUart0RxOverflow, kDifPlicMaxPriority,
+       kDifPlicIrqTriggerLevel, kPlicTarget},
+      {kTopAthosPlicIrqIdUart0TxEmpty, kDifPlicMaxPriority,
+       kDifPlicIrqTriggerLevel, kPlicTarget},
+      {kTopAthosPlicIrqIdUart0RxWatermark, kDifPlicMaxPriority,
+       kDifPlicIrqTriggerLevel, kPlicTarget},
+      {kTopAthosPlicIrqIdUart0TxWatermark, kDifPlicMaxPriority,
+       kDifPlicIrqTriggerLevel, kPlicTarget},
+  };
 
   // Set Ibex IRQ priority threshold level
   CHECK(dif_plic_target_set_threshold(&plic0, kPlicTarget,
                                       kDifPlicMinPriority) == kDifPlicOk,
         "threshold set failed!");
 
-  // Enable IRQs in PLIC
-  //edited----------------------------------
-  CHECK(dif_plic_irq_set_enabled(plic, kTopAthosPlicIrqIdUart0RxParityErr,
-                                 kPlicTarget,
-                                 kDifPlicToggleEnabled) == kDifPlicOk,
-        "interrupt Enable for RX parity error failed!");
-  CHECK(dif_plic_irq_set_enabled(plic, kTopAthosPlicIrqIdUart0RxTimeout,
-                                 kPlicTarget,
-                                 kDifPlicToggleEnabled) == kDifPlicOk,
-        "interrupt Enable for RX FIFO timeout expires before it is emptied error failed!");
-  CHECK(dif_plic_irq_set_enabled(plic, kTopAthosPlicIrqIdUart0RxBreakErr,
-                                 kPlicTarget,
-                                 kDifPlicToggleEnabled) == kDifPlicOk,
-        "interrupt Enable for  RX break condition failed!");
-  CHECK(dif_plic_irq_set_enabled(plic, kTopAthosPlicIrqIdUart0RxFrameErr,
-                                 kPlicTarget,
-                                 kDifPlicToggleEnabled) == kDifPlicOk,
-        "interrupt Enable for RX framing error failed!");
-  //edited--------------------------------------
-  CHECK(dif_plic_irq_set_enabled(plic, kTopAthosPlicIrqIdUart0RxOverflow,
-                                 kPlicTarget,
-                                 kDifPlicToggleEnabled) == kDifPlicOk,
-        "interrupt Enable for RX overflow failed!");
-
-  CHECK(dif_plic_irq_set_enabled(plic, kTopAthosPlicIrqIdUart0TxEmpty,
-                                 kPlicTarget,
-                                 kDifPlicToggleEnabled) == kDifPlicOk,
-        "interrupt Enable for TX empty failed!");
-  //edited
-  CHECK(dif_plic_irq_set_enabled(plic, kTopAthosPlicIrqIdUart0RxWatermark,
-                                 kPlicTarget,
-                                 kDifPlicToggleEnabled) == kDifPlicOk,
-        "interrupt Enable for RX FIFO goes over its watermark failed!");
-
-  CHECK(dif_plic_irq_set_enabled(plic, kTopAthosPlicIrqIdUart0TxWatermark,
-                                 kPlicTarget,
-                                 kDifPlicToggleEnabled) == kDifPlicOk,
-        "interrupt Enable for  TX FIFO dips below its watermark failed!");
-  //edited
+  // Set IRQ triggers to be level triggered, IRQ priorities to MAX, and enable
+  // IRQs in PLIC, each trigger and enable register in one write.
+  CHECK(plic_batch_configure(plic, irqs, ARRAYSIZE(irqs)) == kDifPlicOk,
+        "PLIC IRQ configuration failed!");
 }
 
 static void execute_test(dif_uart_t *uart) {
-  //edited---------------------------------------
-  // Force UART RX parity error interrupt.
-  uart_rx_parity_err_handled = false;
-  CHECK(dif_uart_irq_force(uart, kDifUartIrqRxParityErr) == kDifUartOk,
-        "failed to force RX parity error IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!uart_rx_parity_err_handled) {
-    usleep(10);
-  }
-  CHECK(uart_rx_parity_err_handled, "RX parity error IRQ has not been handled!");
-
-  // Force UART RX FIFO timeout expires before it is emptied interrupt.
-  uart_rx_timeout_handled = false;
-  CHECK(dif_uart_irq_force(uart, kDifUartIrqRxTimeout) == kDifUartOk,
-        "failed to force RX FIFO timeout expires before it is emptied IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!uart_rx_timeout_handled) {
-    usleep(10);
-  }
-  CHECK(uart_rx_timeout_handled, "RX FIFO timeout expires before it is emptied IRQ has not been handled!");
-
-  // Force UART RX break condition interrupt.
-  uart_rx_break_err_handled = false;
-  CHECK(dif_uart_irq_force(uart, kDifUartIrqRxBreakErr) == kDifUartOk,
-        "failed to force RX break condition IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!uart_rx_break_err_handled) {
-    usleep(10);
-  }
-  CHECK(uart_rx_break_err_handled, "RX break condition IRQ has not been handled!");
-
-  // Force UART RX framing error interrupt.
-  uart_rx_frame_err_handled = false;
-  CHECK(dif_uart_irq_force(uart, kDifUartIrqRxFrameErr) == kDifUartOk,
-        "failed to force RX framing error IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!uart_rx_frame_err_handled) {
-    usleep(10);
-  }
-  CHECK(uart_rx_frame_err_handled, "RX framing erro IRQ has not been handled!");
-  //edited---------------------------------------
+  irq_completion_clear(&uart_irqs_handled, kUartIrqsAll);
 
-  // Force UART RX overflow interrupt.
-  uart_rx_overflow_handled = false;
-  CHECK(dif_uart_irq_force(uart, kDifUartIrqRxOverflow) == kDifUartOk,
-        "failed to force RX overflow IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!uart_rx_overflow_handled) {
-    usleep(10);
-  }
-  CHECK(uart_rx_overflow_handled, "RX overflow IRQ has not been handled!");
-
-  // Force UART TX empty interrupt.
-  uart_tx_empty_handled = false;
-  CHECK(dif_uart_irq_force(uart, kDifUartIrqTxEmpty) == kDifUartOk,
-        "failed to force TX empty IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!uart_tx_empty_handled) {
-    usleep(10);
+  // Force every UART interrupt, all of them in flight at once.
+  for (dif_uart_irq_t irq = 0; irq <= kDifUartIrqLast; ++irq) {
+    CHECK(dif_uart_irq_force(uart, irq) == kDifUartOk,
+          "failed to force UART IRQ %d!", irq);
   }
-  CHECK(uart_tx_empty_handled, "TX empty IRQ has not been handled!"); 
-
-  //edited
-  // Force UART RX FIFO goes over its watermark interrupt.
-  uart_rx_watermark_handled = false;
-  CHECK(dif_uart_irq_force(uart, kDifUartIrqRxWatermark) == kDifUartOk,
-        "failed to force RX FIFO goes over its watermark IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!uart_rx_watermark_handled) {
-    usleep(10);
-  }
-  CHECK(uart_rx_watermark_handled, "RX FIFO goes over its watermark IRQ has not been handled!");
-
-  // Force UART TX FIFO dips below its watermark interrupt.
-  uart_tx_watermark_handled = false;
-  CHECK(dif_uart_irq_force(uart, kDifUartIrqTxWatermark) == kDifUartOk,
-        "failed to force TX FIFO dips below its watermark IRQ!");
-  // Check if the IRQ has occured and has been handled appropriately.
-  if (!uart_tx_watermark_handled) {
-    usleep(10);
-  }
-  CHECK(uart_tx_watermark_handled, "TX FIFO dips below its watermark IRQ has not been handled!");
-  //edited
+
+  // Wait for all of them to be handled.
+  CHECK(irq_completion_await(&uart_irqs_handled, kUartIrqsAll,
+                             kIrqTimeoutUsec, NULL),
+        "UART IRQs 0x%x have not been handled!",
+        kUartIrqsAll & ~uart_irqs_handled.bits);
 }
 
 const test_config_t kTestConfig = {
@@ -424,6 +227,11 @@ bool test_main(void) {
       mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR);
   plic_initialise(plic_base_addr, &plic0);
 
+  mmio_region_t timer_base_addr =
+      mmio_region_from_addr(TOP_ATHOS_RV_TIMER_BASE_ADDR);
+  timer_initialise(timer_base_addr, &timer);
+
+  plic_register_irqs();
   uart_configure_irqs(&uart0);
   plic_configure_irqs(&plic0);
   execute_test(&uart0);
@@ -9,6 +9,7 @@
 #include "dif/dif_rstmgr.h"
 #include "dif/check.h"
 #include "dif/test_main.h"
+#include "profile.h"
 
 #include "top/sw/autogen/top_athos.h"  // Generated.
 
@@ -20,13 +21,19 @@ bool test_main(void) {
   dif_rstmgr_params_t params = {
       .base_addr = mmio_region_from_addr(TOP_ATHOS_RSTMGR_AON_BASE_ADDR),
   };
-  CHECK(dif_rstmgr_init(params, &rstmgr) == kDifRstmgrOk);
+  profile_init();
+  CHECK(PROFILE_CALL("dif_rstmgr_init", dif_rstmgr_init(params, &rstmgr)) ==
+        kDifRstmgrOk);
 
   dif_rstmgr_reset_info_bitfield_t info;
-  CHECK(dif_rstmgr_reset_info_get(&rstmgr, &info) == kDifRstmgrOk);
+  CHECK(PROFILE_CALL("dif_rstmgr_reset_info_get",
+                     dif_rstmgr_reset_info_get(&rstmgr, &info)) ==
+        kDifRstmgrOk);
 
   // Only POR reset cause should be set (assuming normal power-up).
   CHECK((info & kDifRstmgrResetInfoPor) == info);
 
+  profile_dump();
+
   return true;
 }
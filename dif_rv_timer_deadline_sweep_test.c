@@ -0,0 +1,208 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_rv_timer.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "irq_lock.h"
+#include "rv_timer_tick_params.h"
+#include "sample_stats.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * rv_timer deadline accuracy test.
+ *
+ * Arms deadlines from a microsecond to seconds, repeatedly, reads the counter
+ * on entry to the timer ISR, and reports for each deadline how late the
+ * interrupt arrived (min/mean/p99/max) and its jitter (max - min). The
+ * counter runs at the peripheral clock, so lateness is resolved to a single
+ * peripheral cycle.
+ *
+ * Deadlines are armed in whole ticks, rounded down; those below one tick on
+ * the running device are skipped, and every row reports the ticks armed.
+ *
+ * Also reports the shortest deadline that can be trusted: the shortest one
+ * from which on the p99 lateness stays within `kTrustPercent` percent of the
+ * deadline.
+ */
+
+static const uint32_t kHart = (uint32_t)kTopAthosPlicTargetIbex0;
+static const uint32_t kComparator = 0;
+
+static const uint32_t kDeadlinesUsec[] = {
+    1,    2,     5,      10,      20,     50,     100,
+    200,  500,   1000,   10000,   100000, 1000000, 2000000,
+};
+
+/**
+ * Longest deadline run in simulation; the longer ones take too long there.
+ */
+static const uint32_t kMaxDeadlineUsecSim = 1000;
+
+enum {
+  kMaxSamples = 64,
+  kMinSamples = 2,
+  kSamplesSim = 4,
+  /**
+   * Time spent per deadline, bounding the samples of the long ones.
+   */
+  kRunBudgetUsec = 4000000,
+  kTrustPercent = 10,
+};
+
+static dif_rv_timer_t timer;
+
+static sample_stats_t results[ARRAYSIZE(kDeadlinesUsec)];
+/**
+ * Ticks armed for each deadline; 0 if it was skipped.
+ */
+static uint32_t deadline_ticks[ARRAYSIZE(kDeadlinesUsec)];
+static uint32_t samples[kMaxSamples];
+
+static volatile uint64_t irq_counter;
+static volatile bool irq_fired;
+
+/**
+ * Timer interrupt handler
+ *
+ * Reads the counter before anything else.
+ */
+void handler_irq_timer(void) {
+  uint64_t counter;
+  CHECK(dif_rv_timer_counter_read(&timer, kHart, &counter) == kDifRvTimerOk);
+  irq_counter = counter;
+
+  CHECK(dif_rv_timer_arm(&timer, kHart, kComparator, UINT64_MAX) ==
+        kDifRvTimerOk);
+  CHECK(dif_rv_timer_irq_clear(&timer, kHart, kComparator) == kDifRvTimerOk);
+  irq_fired = true;
+}
+
+/**
+ * Arms a deadline `ticks` from now, and returns how late its interrupt was.
+ */
+static uint32_t measure_deadline(uint64_t ticks) {
+  uint64_t now;
+  CHECK(dif_rv_timer_counter_read(&timer, kHart, &now) == kDifRvTimerOk);
+  uint64_t deadline = now + ticks;
+  irq_fired = false;
+  CHECK(dif_rv_timer_arm(&timer, kHart, kComparator, deadline) ==
+        kDifRvTimerOk);
+
+  // Interrupts are masked while checking, so that the interrupt cannot be
+  // missed between the check and the WFI; it still ends the WFI.
+  for (;;) {
+    uint32_t irq_state = irq_lock_acquire();
+    if (irq_fired) {
+      irq_lock_release(irq_state);
+      break;
+    }
+    wait_for_interrupt();
+    irq_lock_release(irq_state);
+  }
+
+  CHECK(irq_counter >= deadline, "IRQ %d ticks before the deadline",
+        (uint32_t)(deadline - irq_counter));
+  return (uint32_t)(irq_counter - deadline);
+}
+
+const test_config_t kTestConfig;
+
+bool test_main(void) {
+  LOG_INFO("Running rv_timer deadline sweep test");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+
+  CHECK(dif_rv_timer_init(
+            mmio_region_from_addr(TOP_ATHOS_RV_TIMER_BASE_ADDR),
+            (dif_rv_timer_config_t){.hart_count = 1, .comparator_count = 1},
+            &timer) == kDifRvTimerOk);
+  dif_rv_timer_tick_params_t tick_params;
+  CHECK(rv_timer_tick_params_get(kClockFreqPeripheralHz, &tick_params) ==
+        kDifRvTimerApproximateTickParamsOk);
+  CHECK(dif_rv_timer_set_tick_params(&timer, kHart, tick_params) ==
+        kDifRvTimerOk);
+  CHECK(dif_rv_timer_arm(&timer, kHart, kComparator, UINT64_MAX) ==
+        kDifRvTimerOk);
+  CHECK(dif_rv_timer_irq_enable(&timer, kHart, kComparator,
+                                kDifRvTimerEnabled) == kDifRvTimerOk);
+  CHECK(dif_rv_timer_counter_set_enabled(&timer, kHart, kDifRvTimerEnabled) ==
+        kDifRvTimerOk);
+
+  irq_global_ctrl(true);
+  irq_timer_ctrl(true);
+
+  size_t deadlines = 0;
+  for (; deadlines < ARRAYSIZE(kDeadlinesUsec); ++deadlines) {
+    uint32_t usec = kDeadlinesUsec[deadlines];
+    if (is_sim && usec > kMaxDeadlineUsecSim) {
+      break;
+    }
+    uint32_t ticks = (uint64_t)usec * kClockFreqPeripheralHz / 1000000;
+    deadline_ticks[deadlines] = ticks;
+    if (ticks == 0) {
+      continue;
+    }
+    uint32_t count = kRunBudgetUsec / usec;
+    if (is_sim) {
+      count = kSamplesSim;
+    } else if (count > kMaxSamples) {
+      count = kMaxSamples;
+    } else if (count < kMinSamples) {
+      count = kMinSamples;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+      samples[i] = measure_deadline(ticks);
+    }
+    results[deadlines] = sample_stats_compute(samples, count);
+  }
+
+  CHECK(dif_rv_timer_irq_enable(&timer, kHart, kComparator,
+                                kDifRvTimerDisabled) == kDifRvTimerOk);
+
+  LOG_INFO("counter at %d Hz; lateness in ticks",
+           (uint32_t)kClockFreqPeripheralHz);
+  int trusted = -1;
+  for (size_t i = 0; i < deadlines; ++i) {
+    uint32_t ticks = deadline_ticks[i];
+    if (ticks == 0) {
+      LOG_INFO("deadline %dus: below one tick, skipped", kDeadlinesUsec[i]);
+      continue;
+    }
+    const sample_stats_t *stats = &results[i];
+    LOG_INFO(
+        "deadline %dus (%u ticks): samples=%u min=%u mean=%u p99=%u max=%u "
+        "jitter=%u",
+        kDeadlinesUsec[i], ticks, stats->count, stats->min, stats->mean,
+        stats->p99, stats->max, stats->max - stats->min);
+
+    if ((uint64_t)stats->p99 * 100 > (uint64_t)ticks * kTrustPercent) {
+      trusted = -1;
+    } else if (trusted < 0) {
+      trusted = i;
+    }
+  }
+  if (trusted < 0) {
+    LOG_INFO("no deadline within %d%% p99 lateness", kTrustPercent);
+  } else {
+    LOG_INFO(
+        "shortest trusted deadline: %dus (%u ticks, p99 lateness within "
+        "%d%%)",
+        kDeadlinesUsec[trusted], deadline_ticks[trusted], kTrustPercent);
+  }
+
+  LOG_INFO("Completed Running rv_timer deadline sweep test");
+
+  return true;
+}
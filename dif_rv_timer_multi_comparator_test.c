@@ -0,0 +1,137 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_rv_timer.h"
+
+#include "dif/device.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "irq_lock.h"
+#include "rv_timer_service.h"
+#include "sample_stats.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * rv_timer multi-comparator test.
+ *
+ * Arms every comparator of the hart at staggered deadlines, in increasing
+ * comparator order on even rounds and in decreasing order on odd ones, and
+ * checks that each comparator's own handler is called once per round, not
+ * before its deadline, and in deadline order. Reports the lateness of each
+ * comparator.
+ *
+ * Only the comparators of this hart are armed: those of other harts
+ * interrupt other cores.
+ */
+
+static const uint32_t kHart = (uint32_t)kTopAthosPlicTargetIbex0;
+
+static const uint64_t kTickFreqHz = 1000 * 1000;  // 1 MHz.
+
+/**
+ * First deadline of a round, and spacing of the following ones, in ticks.
+ */
+static const uint64_t kLeadTicks = 100;
+static const uint64_t kStaggerTicks = 20;
+
+enum {
+  kRounds = 64,
+  kRoundsSim = 4,
+};
+
+typedef struct comparator_state {
+  uint32_t comparator;
+  uint32_t fired;
+  uint32_t lateness[kRounds];
+} comparator_state_t;
+
+static dif_rv_timer_t timer;
+static comparator_state_t states[kRvTimerServiceComparators];
+
+static volatile uint32_t fired_count;
+static uint64_t last_deadline;
+static bool out_of_order;
+
+void handler_irq_timer(void) { rv_timer_service_handle_irq(); }
+
+static void on_deadline(void *ctx, uint64_t deadline) {
+  comparator_state_t *state = ctx;
+  uint64_t now = rv_timer_service_now(kHart);
+  CHECK(now >= deadline, "comparator %d expired %d ticks early",
+        state->comparator, (uint32_t)(deadline - now));
+  if (deadline < last_deadline) {
+    out_of_order = true;
+  }
+  last_deadline = deadline;
+  state->lateness[state->fired++] = (uint32_t)(now - deadline);
+  ++fired_count;
+}
+
+const test_config_t kTestConfig;
+
+bool test_main(void) {
+  LOG_INFO("Running rv_timer multi-comparator test");
+
+  uint32_t rounds = kDeviceType == kDeviceSimDV ||
+                            kDeviceType == kDeviceSimVerilator
+                        ? kRoundsSim
+                        : kRounds;
+
+  rv_timer_service_init(kTickFreqHz, &timer);
+  for (uint32_t i = 0; i < kRvTimerServiceComparators; ++i) {
+    states[i] = (comparator_state_t){.comparator = i};
+    rv_timer_service_set_handler(kHart, i, on_deadline, &states[i]);
+  }
+
+  irq_global_ctrl(true);
+
+  for (uint32_t round = 0; round < rounds; ++round) {
+    fired_count = 0;
+    last_deadline = 0;
+    // All comparators are armed before the first one is due.
+    uint32_t irq_state = irq_lock_acquire();
+    uint64_t start = rv_timer_service_now(kHart) + kLeadTicks;
+    for (uint32_t i = 0; i < kRvTimerServiceComparators; ++i) {
+      uint32_t position =
+          round % 2 == 0 ? i : kRvTimerServiceComparators - 1 - i;
+      rv_timer_service_arm(kHart, i, start + position * kStaggerTicks);
+    }
+    irq_lock_release(irq_state);
+
+    // Interrupts are masked while checking, so that the last deadline cannot
+    // be missed between the check and the WFI; it still ends the WFI.
+    for (;;) {
+      irq_state = irq_lock_acquire();
+      if (fired_count >= kRvTimerServiceComparators) {
+        irq_lock_release(irq_state);
+        break;
+      }
+      wait_for_interrupt();
+      irq_lock_release(irq_state);
+    }
+    CHECK(!out_of_order, "comparators expired out of deadline order");
+    for (uint32_t i = 0; i < kRvTimerServiceComparators; ++i) {
+      CHECK(states[i].fired == round + 1,
+            "comparator %d expired %d times in %d rounds", i, states[i].fired,
+            round + 1);
+    }
+  }
+
+  LOG_INFO("%d harts, %d comparators per hart, %d rounds, %d ticks apart",
+           kRvTimerServiceHarts, kRvTimerServiceComparators, rounds,
+           (uint32_t)kStaggerTicks);
+  for (uint32_t i = 0; i < kRvTimerServiceComparators; ++i) {
+    sample_stats_t stats = sample_stats_compute(states[i].lateness, rounds);
+    LOG_INFO("comparator %d lateness: min=%u mean=%u p99=%u max=%u ticks", i,
+             stats.min, stats.mean, stats.p99, stats.max);
+  }
+
+  LOG_INFO("Completed Running rv_timer multi-comparator test");
+
+  return true;
+}
@@ -0,0 +1,198 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_rv_timer.h"
+
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "irq_lock.h"
+#include "profile.h"
+#include "rv_timer_tick_params.h"
+#include "timer_wheel.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * Periodic timer drift test.
+ *
+ * Runs a periodic timer of the wheel for `kPeriods` periods, and checks that
+ * every expiry lies exactly on the grid of the first expiry and the period:
+ * interrupt latency must not add up to drift. One expiry holds the interrupt
+ * for more than two periods, which must be counted as two overruns and not
+ * shift the grid either.
+ *
+ * For comparison, first restarts a one-shot timer from its own expiry for
+ * `kNaivePeriods` periods, which drifts by the latency of every restart.
+ * Reports the drift of both, the lateness of the periodic expiries, and the
+ * cost of the timer ISR per period.
+ */
+
+static const uint32_t kHart = (uint32_t)kTopAthosPlicTargetIbex0;
+static const uint32_t kComparator = 0;
+
+static const uint64_t kTickFreqHz = 1000 * 1000;  // 1 MHz.
+static const uint64_t kPeriodTicks = 100;
+
+/**
+ * Period on Verilator, where the CPU runs at a few hundred kHz: a 100 tick
+ * period would be shorter than the timer ISR, and nearly every one would
+ * overrun.
+ */
+static const uint64_t kPeriodTicksSimVerilator = 10000;
+
+enum {
+  kPeriods = 100000,
+  kPeriodsSim = 100,
+  kNaivePeriods = 1000,
+  kNaivePeriodsSim = 20,
+  /**
+   * Overruns forced by the expiry at `kOverrunAt`.
+   */
+  kForcedOverruns = 2,
+  kOverrunAt = 1000,
+  kOverrunAtSim = 50,
+};
+
+static dif_rv_timer_t timer;
+static timer_wheel_timer_t wheel_timer;
+
+static uint64_t period_ticks;
+static uint32_t periods;
+static uint32_t overrun_at;
+static uint64_t first_expiry;
+static uint32_t expiries;
+static bool off_grid;
+static uint32_t max_lateness;
+static uint64_t total_lateness;
+static volatile bool done;
+
+void handler_irq_timer(void) {
+  PROFILE_SCOPE("timer_isr");
+  timer_wheel_handle_irq();
+}
+
+static void on_naive_expiry(void *ctx) {
+  if (++expiries < periods) {
+    timer_wheel_start(&wheel_timer, period_ticks);
+  } else {
+    done = true;
+  }
+}
+
+static void on_periodic_expiry(void *ctx) {
+  uint64_t now = timer_wheel_now();
+  uint64_t period_index = expiries + wheel_timer.overruns;
+  if (wheel_timer.expiry != first_expiry + period_index * period_ticks) {
+    off_grid = true;
+  }
+  uint32_t lateness = (uint32_t)(now - wheel_timer.expiry);
+  total_lateness += lateness;
+  if (lateness > max_lateness) {
+    max_lateness = lateness;
+  }
+  ++expiries;
+
+  if (expiries == overrun_at) {
+    // Past the next `kForcedOverruns` periods, and well before the one after.
+    uint64_t until =
+        wheel_timer.expiry + kForcedOverruns * period_ticks + period_ticks / 2;
+    while (timer_wheel_now() < until) {
+    }
+  }
+  if (period_index + 1 >= periods) {
+    timer_wheel_cancel(&wheel_timer);
+    done = true;
+  }
+}
+
+static void wait_done(void) {
+  // Interrupts are masked while checking, so that the last expiry cannot be
+  // missed between the check and the WFI; it still ends the WFI.
+  for (;;) {
+    uint32_t irq_state = irq_lock_acquire();
+    if (done) {
+      irq_lock_release(irq_state);
+      break;
+    }
+    wait_for_interrupt();
+    irq_lock_release(irq_state);
+  }
+}
+
+const test_config_t kTestConfig;
+
+bool test_main(void) {
+  LOG_INFO("Running rv_timer periodic test");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+
+  CHECK(dif_rv_timer_init(
+            mmio_region_from_addr(TOP_ATHOS_RV_TIMER_BASE_ADDR),
+            (dif_rv_timer_config_t){.hart_count = 1, .comparator_count = 1},
+            &timer) == kDifRvTimerOk);
+  dif_rv_timer_tick_params_t tick_params;
+  CHECK(rv_timer_tick_params_get(kTickFreqHz, &tick_params) ==
+        kDifRvTimerApproximateTickParamsOk);
+  CHECK(dif_rv_timer_set_tick_params(&timer, kHart, tick_params) ==
+        kDifRvTimerOk);
+  timer_wheel_init(&timer, kHart, kComparator);
+
+  irq_global_ctrl(true);
+
+  period_ticks = kDeviceType == kDeviceSimVerilator ? kPeriodTicksSimVerilator
+                                                    : kPeriodTicks;
+
+  // One-shot timer restarted relative to the time of its expiry.
+  periods = is_sim ? kNaivePeriodsSim : kNaivePeriods;
+  expiries = 0;
+  done = false;
+  timer_wheel_timer_init(&wheel_timer, on_naive_expiry, NULL);
+  uint64_t naive_start = timer_wheel_now();
+  timer_wheel_start(&wheel_timer, period_ticks);
+  wait_done();
+  uint32_t naive_periods = periods;
+  uint64_t naive_drift =
+      wheel_timer.expiry - (naive_start + naive_periods * period_ticks);
+
+  // Periodic timer.
+  periods = is_sim ? kPeriodsSim : kPeriods;
+  overrun_at = is_sim ? kOverrunAtSim : kOverrunAt;
+  expiries = 0;
+  done = false;
+  timer_wheel_timer_init(&wheel_timer, on_periodic_expiry, NULL);
+  profile_init();
+  first_expiry = timer_wheel_now() + period_ticks;
+  timer_wheel_start_periodic(&wheel_timer, first_expiry, period_ticks);
+  wait_done();
+  CHECK(!timer_wheel_is_active(&wheel_timer), "periodic timer still active");
+
+  CHECK(!off_grid, "periodic expiry off the period grid");
+  CHECK(wheel_timer.overruns == kForcedOverruns, "%d overruns, expected %d",
+        wheel_timer.overruns, kForcedOverruns);
+  CHECK(expiries + wheel_timer.overruns == periods,
+        "%d expiries and %d overruns over %d periods", expiries,
+        wheel_timer.overruns, periods);
+  uint64_t last_expiry = first_expiry + (periods - 1) * period_ticks;
+  CHECK(wheel_timer.expiry == last_expiry, "periodic timer drifted by %d ticks",
+        (uint32_t)(wheel_timer.expiry - last_expiry));
+
+  LOG_INFO("one-shot restart: %d periods of %d ticks, drift=%d ticks",
+           naive_periods, (uint32_t)period_ticks, (uint32_t)naive_drift);
+  LOG_INFO(
+      "periodic: %d periods of %d ticks, drift=0 ticks, overruns=%d, "
+      "lateness mean=%d max=%d ticks",
+      periods, (uint32_t)period_ticks, wheel_timer.overruns,
+      (uint32_t)(total_lateness / expiries), max_lateness);
+  profile_dump();
+
+  LOG_INFO("Completed Running rv_timer periodic test");
+
+  return true;
+}
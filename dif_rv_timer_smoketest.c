@@ -7,6 +7,10 @@
 
 #include "dif/dif_rv_timer.h"
 
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/dif_plic.h"
+#include "dif/dif_uart.h"
 #include "dif/handler.h"
 #include "dif/irq.h"
 #include "dif/hart.h"
@@ -14,9 +18,19 @@
 #include "dif/log.h"
 #include "dif/check.h"
 #include "dif/test_main.h"
+#include "log_token.h"
+#include "rv_timer_tick_params.h"
 #include "top/sw/autogen/top_athos.h"
 
 static dif_rv_timer_t timer;
+static dif_plic_t plic0;
+static dif_uart_t uart0;
+
+static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
+
+// Records logged from the timer ISR are queued here, and drained by the UART
+// TX interrupts, so that logging does not distort the interrupt timing.
+static uint8_t log_ring[1024];
 
 // Flag for checking whether the interrupt handler was called. When the handler
 // is entered, this value *must* be set to false, to catch false positives.
@@ -33,31 +47,106 @@ static const uint32_t kComparator = 0;
 static const uint64_t kTickFreqHz = 1000 * 1000;  // 1 MHz.
 
 static void test_handler(void) {
-  CHECK(!irq_fired, "Entered IRQ handler, but `irq_fired` was not false!");
+  LOG_TOKEN_CHECK(!irq_fired,
+                  "Entered IRQ handler, but `irq_fired` was not false!");
 
   bool irq_flag;
-  CHECK(dif_rv_timer_irq_get(&timer, kHart, kComparator, &irq_flag) ==
-        kDifRvTimerOk);
-  CHECK(irq_flag, "Entered IRQ handler but the expected IRQ flag wasn't set!");
+  LOG_TOKEN_CHECK(dif_rv_timer_irq_get(&timer, kHart, kComparator,
+                                       &irq_flag) == kDifRvTimerOk);
+  LOG_TOKEN_CHECK(irq_flag,
+                  "Entered IRQ handler but the expected IRQ flag wasn't set!");
 
-  CHECK(dif_rv_timer_counter_set_enabled(&timer, kHart, kDifRvTimerDisabled) ==
-        kDifRvTimerOk);
-  CHECK(dif_rv_timer_irq_clear(&timer, kHart, kComparator) == kDifRvTimerOk);
+  LOG_TOKEN_CHECK(dif_rv_timer_counter_set_enabled(
+                      &timer, kHart, kDifRvTimerDisabled) == kDifRvTimerOk);
+  LOG_TOKEN_CHECK(dif_rv_timer_irq_clear(&timer, kHart, kComparator) ==
+                  kDifRvTimerOk);
 
   irq_fired = true;
 }
 
 // Register our own IRQ handler by overriding a weak symbol in `handler.h`.
 void handler_irq_timer(void) {
-  LOG_INFO("Entering handler_irq_timer()");
+  LOG_TOKEN_INFO("Entering handler_irq_timer()");
   test_handler();
-  LOG_INFO("Exiting handler_irq_timer()");
+  LOG_TOKEN_INFO("Exiting handler_irq_timer()");
+}
+
+/**
+ * External interrupt handler
+ *
+ * Drains the deferred log ring on the UART0 TX interrupts.
+ */
+void handler_irq_external(void) {
+  // Claim the IRQ by reading the Ibex specific CC register.
+  dif_plic_irq_id_t interrupt_id;
+  LOG_TOKEN_CHECK(dif_plic_irq_claim(&plic0, kPlicTarget, &interrupt_id) ==
+                      kDifPlicOk,
+                  "ISR is not implemented!");
+
+  switch (interrupt_id) {
+    case kTopAthosPlicIrqIdUart0TxWatermark:
+      log_token_handle_irq(kDifUartIrqTxWatermark);
+      break;
+    case kTopAthosPlicIrqIdUart0TxEmpty:
+      log_token_handle_irq(kDifUartIrqTxEmpty);
+      break;
+    default:
+      LOG_TOKEN_CHECK(false, "ISR interrupted peripheral is not UART TX!");
+  }
+
+  // Complete the IRQ by writing the IRQ source to the Ibex specific CC
+  // register.
+  LOG_TOKEN_CHECK(dif_plic_irq_complete(&plic0, kPlicTarget, &interrupt_id) ==
+                      kDifPlicOk,
+                  "Unable to complete the IRQ request!");
+}
+
+/**
+ * Sets up deferred tokenized logging on UART0, which the test framework has
+ * already configured for the console.
+ */
+static void log_initialise(void) {
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
+            },
+            &uart0) == kDifUartOk);
+  CHECK(dif_plic_init(
+            (dif_plic_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR),
+            },
+            &plic0) == kDifPlicOk,
+        "PLIC init failed!");
+
+  static const dif_plic_irq_id_t kLogIrqs[] = {
+      kTopAthosPlicIrqIdUart0TxWatermark,
+      kTopAthosPlicIrqIdUart0TxEmpty,
+  };
+  for (int i = 0; i < ARRAYSIZE(kLogIrqs); ++i) {
+    CHECK(dif_plic_irq_set_trigger(&plic0, kLogIrqs[i],
+                                   kDifPlicIrqTriggerLevel) == kDifPlicOk,
+          "trigger type set failed!");
+    CHECK(dif_plic_irq_set_priority(&plic0, kLogIrqs[i],
+                                    kDifPlicMaxPriority) == kDifPlicOk,
+          "priority set failed!");
+    CHECK(dif_plic_irq_set_enabled(&plic0, kLogIrqs[i], kPlicTarget,
+                                   kDifPlicToggleEnabled) == kDifPlicOk,
+          "interrupt Enable failed!");
+  }
+  CHECK(dif_plic_target_set_threshold(&plic0, kPlicTarget,
+                                      kDifPlicMinPriority) == kDifPlicOk,
+        "threshold set failed!");
+
+  log_token_init_deferred(&uart0, log_ring, sizeof(log_ring));
 }
 
 const test_config_t kTestConfig;
 
 bool test_main(void) {
+  log_initialise();
+
   irq_global_ctrl(true);
+  irq_external_ctrl(true);
   irq_timer_ctrl(true);
 
   mmio_region_t timer_reg =
@@ -68,8 +157,7 @@ bool test_main(void) {
             &timer) == kDifRvTimerOk);
 
   dif_rv_timer_tick_params_t tick_params;
-  CHECK(dif_rv_timer_approximate_tick_params(kClockFreqPeripheralHz,
-                                             kTickFreqHz, &tick_params) ==
+  CHECK(rv_timer_tick_params_get(kTickFreqHz, &tick_params) ==
         kDifRvTimerApproximateTickParamsOk);
   CHECK(dif_rv_timer_set_tick_params(&timer, kHart, tick_params) ==
         kDifRvTimerOk);
@@ -99,5 +187,9 @@ bool test_main(void) {
     wait_for_interrupt();
   }
 
+  log_token_flush();
+  CHECK(log_token_dropped() == 0, "%d log records dropped",
+        log_token_dropped());
+
   return true;
 }
@@ -7,6 +7,8 @@
 
 #include "dif/dif_rv_timer.h"
 
+#include "base/mmio.h"
+#include "dif/dif_uart.h"
 #include "dif/handler.h"
 #include "dif/irq.h"
 #include "dif/hart.h"
@@ -14,9 +16,12 @@
 #include "dif/log.h"
 #include "dif/check.h"
 #include "dif/test_main.h"
+#include "log_token.h"
+#include "rv_timer_tick_params.h"
 #include "top/sw/autogen/top_athos.h"
 
 static dif_rv_timer_t timer;
+static dif_uart_t uart0;
 
 // Flag for checking whether the interrupt handler was called. When the handler
 // is entered, this value *must* be set to false, to catch false positives.
@@ -49,14 +54,23 @@ static void test_handler(void) {
 
 // Register our own IRQ handler by overriding a weak symbol in `handler.h`.
 void handler_irq_timer(void) {
-  LOG_INFO("Entering handler_irq_timer()");
+  LOG_TOKEN_INFO("Entering handler_irq_timer()");
   test_handler();
-  LOG_INFO("Exiting handler_irq_timer()");
+  LOG_TOKEN_INFO("Exiting handler_irq_timer()");
 }
 
 const test_config_t kTestConfig;
 
 bool test_main(void) {
+  // Tokenized logs share UART0 with the console, which the test framework has
+  // already configured.
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
+            },
+            &uart0) == kDifUartOk);
+  log_token_init(&uart0);
+
   irq_global_ctrl(true);
   irq_timer_ctrl(true);
 
@@ -77,13 +91,12 @@ bool test_main(void) {
   //-----edited
   
   dif_rv_timer_tick_params_t tick_params;
-  CHECK(dif_rv_timer_approximate_tick_params(kClockFreqPeripheralHz,
-                                             kTickFreqHz, &tick_params) ==
+  CHECK(rv_timer_tick_params_get(kTickFreqHz, &tick_params) ==
         kDifRvTimerApproximateTickParamsOk);
   
   //-----edited
-  LOG_INFO("kClockFreqPeripheralHz = %x",kClockFreqPeripheralHz);
-  LOG_INFO("kTickFreqHz = %x",kTickFreqHz);
+  LOG_TOKEN_INFO("kClockFreqPeripheralHz = %x",kClockFreqPeripheralHz);
+  LOG_TOKEN_INFO("kTickFreqHz = %x",kTickFreqHz);
   //-----edited
   
   CHECK(dif_rv_timer_set_tick_params(&timer, kHart, tick_params) ==
@@ -92,8 +105,8 @@ bool test_main(void) {
                                 kDifRvTimerEnabled) == kDifRvTimerOk);
 
   //-----edited
-  LOG_INFO("kHart = %x",kHart);
-  LOG_INFO("kComparator = %x",kComparator);
+  LOG_TOKEN_INFO("kHart = %x",kHart);
+  LOG_TOKEN_INFO("kComparator = %x",kComparator);
   //-----edited
 
   uint64_t current_time;
@@ -105,21 +118,21 @@ bool test_main(void) {
       
   CHECK(dif_rv_timer_counter_read(&timer, kHart, &current_time) ==
         kDifRvTimerOk);
-  LOG_INFO("Current time: %d; timer theshold: %d", (uint32_t)current_time,
-           (uint32_t)(current_time + kDeadline));
+  LOG_TOKEN_INFO("Current time: %d; timer theshold: %d",
+                 (uint32_t)current_time, (uint32_t)(current_time + kDeadline));
   CHECK(dif_rv_timer_arm(&timer, kHart, kComparator,
                          current_time + kDeadline) == kDifRvTimerOk);
    //-----edited
-  LOG_INFO("kDeadline = %x",kDeadline);
-   LOG_INFO("Current time: %d; timer theshold: %x", (uint32_t)current_time,
-           (uint32_t)(current_time + kDeadline));
+  LOG_TOKEN_INFO("kDeadline = %x",kDeadline);
+   LOG_TOKEN_INFO("Current time: %d; timer theshold: %x",
+                  (uint32_t)current_time, (uint32_t)(current_time + kDeadline));
   //-----edited
 
   irq_fired = false;
   CHECK(dif_rv_timer_counter_set_enabled(&timer, kHart, kDifRvTimerEnabled) ==
         kDifRvTimerOk);
 
-  LOG_INFO("Waiting...");
+  LOG_TOKEN_INFO("Waiting...");
   while (!irq_fired) {
     wait_for_interrupt();
   }
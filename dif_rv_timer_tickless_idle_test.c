@@ -0,0 +1,108 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_rv_timer.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/handler.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "rv_timer_tick_params.h"
+#include "tickless_idle.h"
+#include "timer_wheel.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * Tickless idle test.
+ *
+ * Sleeps until software timers of the wheel expire, for gaps from a few ticks
+ * to a tenth of a second, and checks that each timer expires once, not
+ * early, and that the hart only woke up for the wheel: at most once per
+ * level the deadline was redistributed through, and never for a periodic
+ * tick. Reports the lateness and the number of wakeups of each gap.
+ */
+
+static const uint32_t kHart = (uint32_t)kTopAthosPlicTargetIbex0;
+static const uint32_t kComparator = 0;
+
+static const uint64_t kTickFreqHz = 1000 * 1000;  // 1 MHz.
+
+/**
+ * Gaps between wakeups, in ticks; the long ones are cut short in simulation.
+ */
+static const uint32_t kGaps[] = {
+    20, 50, 200, 500, 2000, 5000, 20000, 100000,
+};
+static const uint32_t kMaxGapSim = 5000;
+
+static dif_rv_timer_t timer;
+
+static timer_wheel_timer_t wakeup;
+static volatile bool expired;
+static uint32_t lateness;
+
+void handler_irq_timer(void) { timer_wheel_handle_irq(); }
+
+static void on_expiry(void *ctx) {
+  uint64_t now = timer_wheel_now();
+  CHECK(now >= wakeup.expiry, "timer expired %d ticks early",
+        (uint32_t)(wakeup.expiry - now));
+  CHECK(!expired, "timer expired twice");
+  lateness = (uint32_t)(now - wakeup.expiry);
+  expired = true;
+}
+
+static bool is_expired(void *ctx) { return expired; }
+
+const test_config_t kTestConfig;
+
+bool test_main(void) {
+  LOG_INFO("Running tickless idle test");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+
+  CHECK(dif_rv_timer_init(
+            mmio_region_from_addr(TOP_ATHOS_RV_TIMER_BASE_ADDR),
+            (dif_rv_timer_config_t){.hart_count = 1, .comparator_count = 1},
+            &timer) == kDifRvTimerOk);
+  dif_rv_timer_tick_params_t tick_params;
+  CHECK(rv_timer_tick_params_get(kTickFreqHz, &tick_params) ==
+        kDifRvTimerApproximateTickParamsOk);
+  CHECK(dif_rv_timer_set_tick_params(&timer, kHart, tick_params) ==
+        kDifRvTimerOk);
+  timer_wheel_init(&timer, kHart, kComparator);
+  timer_wheel_timer_init(&wakeup, on_expiry, NULL);
+
+  irq_global_ctrl(true);
+
+  for (size_t i = 0; i < ARRAYSIZE(kGaps); ++i) {
+    if (is_sim && kGaps[i] > kMaxGapSim) {
+      break;
+    }
+    tickless_idle_stats(true);
+    expired = false;
+    timer_wheel_start(&wakeup, kGaps[i]);
+    tickless_idle_wait(is_expired, NULL);
+    tickless_idle_stats_t stats = tickless_idle_stats(false);
+
+    // No other interrupt is enabled, so the wheel is the only thing that
+    // wakes the hart up: once per level on the way down to the expiry.
+    CHECK(stats.untimed_sleeps == 0, "%dus gap slept without a deadline",
+          kGaps[i]);
+    CHECK(stats.timed_sleeps <= kTimerWheelLevels + 1,
+          "%dus gap woke up %d times", kGaps[i], stats.timed_sleeps);
+    LOG_INFO("gap %dus: lateness=%dus wakeups=%d slept=%dus", kGaps[i],
+             lateness, stats.timed_sleeps, (uint32_t)stats.slept_ticks);
+  }
+  CHECK(timer_wheel_next_deadline() == UINT64_MAX, "timers still active");
+
+  LOG_INFO("Completed Running tickless idle test");
+
+  return true;
+}
@@ -0,0 +1,152 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_rv_timer.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "irq_lock.h"
+#include "rv_timer_tick_params.h"
+#include "timer_wheel.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * Timer wheel test.
+ *
+ * Starts `kTimers` software timers on the single rv_timer comparator, with
+ * deadlines spread over several levels of the wheel, cancels some of them,
+ * and checks that every other one expires exactly once, not before its
+ * deadline, and in deadline order.
+ */
+
+static const uint32_t kHart = (uint32_t)kTopAthosPlicTargetIbex0;
+static const uint32_t kComparator = 0;
+
+static const uint64_t kTickFreqHz = 1000 * 1000;  // 1 MHz.
+
+enum {
+  kTimers = 48,
+  /**
+   * Every `kCancelEvery`th timer is cancelled before it expires.
+   */
+  kCancelEvery = 5,
+};
+
+/**
+ * Longest deadline, in ticks; levels 0 to 2 of the wheel are 64, 4096 and
+ * 262144 ticks long. Logs are not sent over UART in DV, so the deadlines can
+ * be much shorter there.
+ */
+static const uint64_t kMaxDeadline = 300000;
+static const uint64_t kMaxDeadlineSimDV = 5000;
+
+typedef struct test_timer {
+  timer_wheel_timer_t timer;
+  uint32_t fired;
+  uint32_t lateness;
+} test_timer_t;
+
+static dif_rv_timer_t timer;
+static test_timer_t timers[kTimers];
+
+static volatile uint32_t fired_count;
+static uint64_t last_expiry;
+static bool out_of_order;
+
+void handler_irq_timer(void) { timer_wheel_handle_irq(); }
+
+static void on_expiry(void *ctx) {
+  test_timer_t *test_timer = ctx;
+  uint64_t now = timer_wheel_now();
+  CHECK(now >= test_timer->timer.expiry, "timer expired %d ticks early",
+        (uint32_t)(test_timer->timer.expiry - now));
+  test_timer->lateness = (uint32_t)(now - test_timer->timer.expiry);
+  if (test_timer->timer.expiry < last_expiry) {
+    out_of_order = true;
+  }
+  last_expiry = test_timer->timer.expiry;
+  ++test_timer->fired;
+  ++fired_count;
+}
+
+const test_config_t kTestConfig;
+
+bool test_main(void) {
+  LOG_INFO("Running rv_timer wheel test");
+
+  uint64_t max_deadline =
+      kDeviceType == kDeviceSimDV ? kMaxDeadlineSimDV : kMaxDeadline;
+
+  CHECK(dif_rv_timer_init(
+            mmio_region_from_addr(TOP_ATHOS_RV_TIMER_BASE_ADDR),
+            (dif_rv_timer_config_t){.hart_count = 1, .comparator_count = 1},
+            &timer) == kDifRvTimerOk);
+  dif_rv_timer_tick_params_t tick_params;
+  CHECK(rv_timer_tick_params_get(kTickFreqHz, &tick_params) ==
+        kDifRvTimerApproximateTickParamsOk);
+  CHECK(dif_rv_timer_set_tick_params(&timer, kHart, tick_params) ==
+        kDifRvTimerOk);
+  timer_wheel_init(&timer, kHart, kComparator);
+
+  irq_global_ctrl(true);
+
+  // Deadlines from a few ticks to `max_deadline`, not in order; a
+  // multiplicative sequence spreads them over the levels. Interrupts are
+  // masked until every timer is started and the cancelled ones are
+  // cancelled, so that no cancelled timer can expire first.
+  uint32_t expected = 0;
+  uint64_t deadline = 3;
+  uint32_t irq_state = irq_lock_acquire();
+  for (int i = 0; i < kTimers; ++i) {
+    timer_wheel_timer_init(&timers[i].timer, on_expiry, &timers[i]);
+    deadline = deadline * 7 % max_deadline + 1;
+    timer_wheel_start(&timers[i].timer, deadline);
+  }
+  for (int i = 0; i < kTimers; ++i) {
+    if (i % kCancelEvery == kCancelEvery - 1) {
+      timer_wheel_cancel(&timers[i].timer);
+      CHECK(!timer_wheel_is_active(&timers[i].timer));
+    } else {
+      ++expected;
+    }
+  }
+  irq_lock_release(irq_state);
+
+  // Interrupts are masked while checking, so that the last expiry cannot be
+  // missed between the check and the WFI; it still ends the WFI.
+  for (;;) {
+    irq_state = irq_lock_acquire();
+    if (fired_count >= expected) {
+      irq_lock_release(irq_state);
+      break;
+    }
+    wait_for_interrupt();
+    irq_lock_release(irq_state);
+  }
+  CHECK(timer_wheel_next_deadline() == UINT64_MAX, "timers still active");
+
+  uint32_t max_lateness = 0;
+  for (int i = 0; i < kTimers; ++i) {
+    uint32_t fires = i % kCancelEvery == kCancelEvery - 1 ? 0 : 1;
+    CHECK(timers[i].fired == fires, "timer %d expired %d times, expected %d",
+          i, timers[i].fired, fires);
+    if (timers[i].lateness > max_lateness) {
+      max_lateness = timers[i].lateness;
+    }
+  }
+  CHECK(!out_of_order, "timers expired out of deadline order");
+  LOG_INFO("%d timers expired, %d cancelled, max lateness %d ticks",
+           expected, kTimers - expected, max_lateness);
+
+  LOG_INFO("Completed Running rv_timer wheel test");
+
+  return true;
+}
@@ -8,10 +8,14 @@
 #include "dif/dif_uart.h"
 
 #include "dif/device.h"
+#include "base/memory.h"
 #include "base/mmio.h"
 #include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/log.h"
 #include "dif/check.h"
 #include "dif/test_main.h"
+#include "uart_burst.h"
 #include "top/sw/autogen/top_athos.h"  // Generated.
 
 static const uint8_t kSendData[] = "BCI DIF Test!";
@@ -19,6 +23,129 @@ static const uint8_t kSendData[] = "BCI DIF Test!";
 uint8_t debugSendData[128];
 uint8_t debugRecvData[128]; 
 
+/**
+ * Payload sizes of the burst sweep, in bytes.
+ */
+static const size_t kSweepSizes[] = {1, 4, 16, 32, 64, 256, 1024, 4096};
+
+/**
+ * Largest payload of the sweep that is run in simulation; the bigger ones take
+ * too long there.
+ */
+static const size_t kSweepMaxSizeSim = 64;
+
+/**
+ * Chunk size for the `dif_uart_send_N_bytes()` reference path, small enough
+ * for a chunk to never overflow the RX FIFO in loopback.
+ */
+static const size_t kReferenceChunkBytes = 16;
+
+static uint8_t sweep_send_data[4096];
+static uint8_t sweep_recv_data[4096];
+
+/**
+ * Cycles per byte of each sweep size, logged once loopback is off.
+ */
+static uint32_t n_bytes_cycles_per_byte[ARRAYSIZE(kSweepSizes)];
+static uint32_t burst_cycles_per_byte[ARRAYSIZE(kSweepSizes)];
+
+/**
+ * Loops `len` bytes back through `dif_uart_send_N_bytes()` /
+ * `dif_uart_receive_N_bytes()`.
+ *
+ * @return The number of CPU cycles taken.
+ */
+static uint64_t loopback_n_bytes(const dif_uart_t *uart, size_t len) {
+  uint64_t start = ibex_mcycle_read();
+  for (size_t done = 0; done < len; done += kReferenceChunkBytes) {
+    size_t chunk =
+        len - done < kReferenceChunkBytes ? len - done : kReferenceChunkBytes;
+    CHECK(dif_uart_send_N_bytes(uart, &sweep_send_data[done], chunk) ==
+          kDifUartOk);
+    CHECK(dif_uart_receive_N_bytes(uart, &sweep_recv_data[done], chunk) ==
+          kDifUartOk);
+  }
+  return ibex_mcycle_read() - start;
+}
+
+/**
+ * Loops `len` bytes back with FIFO depth aware bursts, keeping the TX FIFO
+ * topped up while draining the RX FIFO.
+ *
+ * @return The number of CPU cycles taken.
+ */
+static uint64_t loopback_burst(const dif_uart_t *uart, size_t len) {
+  size_t sent = 0;
+  size_t received = 0;
+
+  uint64_t start = ibex_mcycle_read();
+  while (received < len) {
+    size_t count;
+    if (sent < len) {
+      CHECK(uart_burst_fill(uart, &sweep_send_data[sent], len - sent,
+                            &count) == kDifUartOk);
+      sent += count;
+    }
+    CHECK(uart_burst_drain(uart, len - received, &sweep_recv_data[received],
+                           &count) == kDifUartOk);
+    received += count;
+  }
+  return ibex_mcycle_read() - start;
+}
+
+static void check_sweep_data(size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    CHECK(sweep_recv_data[i] == sweep_send_data[i],
+          "byte %d: sent 0x%x, received 0x%x", i, sweep_send_data[i],
+          sweep_recv_data[i]);
+    sweep_recv_data[i] = 0;
+  }
+}
+
+/**
+ * Sweeps the payload size and records the cycles per byte of the reference
+ * and of the burst path.
+ *
+ * Nothing is logged here: UART0 is in loopback, so the log output would be
+ * received as sweep data.
+ *
+ * @return The number of sizes run.
+ */
+static size_t run_burst_sweep(const dif_uart_t *uart) {
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+
+  for (size_t i = 0; i < sizeof(sweep_send_data); ++i) {
+    sweep_send_data[i] = (uint8_t)(i ^ (i >> 8));
+  }
+
+  size_t sizes = 0;
+  for (; sizes < ARRAYSIZE(kSweepSizes); ++sizes) {
+    size_t len = kSweepSizes[sizes];
+    if (is_sim && len > kSweepMaxSizeSim) {
+      break;
+    }
+
+    uint64_t n_bytes_cycles = loopback_n_bytes(uart, len);
+    check_sweep_data(len);
+
+    uint64_t burst_cycles = loopback_burst(uart, len);
+    check_sweep_data(len);
+
+    n_bytes_cycles_per_byte[sizes] = (uint32_t)(n_bytes_cycles / len);
+    burst_cycles_per_byte[sizes] = (uint32_t)(burst_cycles / len);
+  }
+  return sizes;
+}
+
+static void report_burst_sweep(size_t sizes) {
+  for (size_t i = 0; i < sizes; ++i) {
+    LOG_INFO("size %d: N_bytes %d cycles/byte, burst %d cycles/byte",
+             kSweepSizes[i], n_bytes_cycles_per_byte[i],
+             burst_cycles_per_byte[i]);
+  }
+}
+
 const test_config_t kTestConfig = {
     .can_clobber_uart = true,
 };
@@ -58,6 +185,12 @@ bool test_main(void) {
     debugSendData[i] = kSendData[i];
     debugRecvData[i] = receive_bytes[i];
   }
+
+  size_t sizes = run_burst_sweep(&uart);
+
+  CHECK(dif_uart_loopback_set(&uart, kDifUartLoopbackSystem,
+                              kDifUartToggleDisabled) == kDifUartOk);
+  report_burst_sweep(sizes);
   
   LOG_INFO("Completed Running BCI uart dif test");
 
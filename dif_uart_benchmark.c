@@ -0,0 +1,314 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_uart.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/dif_plic.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "uart_burst.h"
+#include "uart_irq_engine.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+#include "uart_regs.h"                 // Generated.
+
+/**
+ * UART loopback throughput benchmark.
+ *
+ * Sweeps baud rate, payload size, loopback mode and transfer mode, and emits
+ * one result line per run:
+ *
+ *   BENCH uart baud=<u> loopback=<system|line> mode=<polled|burst|irq>
+ *         bytes=<u> cycles=<u>
+ *
+ * (on a single line), where `cycles` is the `mcycle` delta of the transfer.
+ * In system loopback the payload is sent and received back. In line loopback
+ * the RX pin is forwarded to the TX pin and nothing reaches the receiver, so
+ * those runs only time the transmission of the payload, until the
+ * transmitter is idle again.
+ *
+ * Baud rates that cannot be generated from the peripheral clock emit
+ * `status=unsupported` instead of `bytes` and `cycles`.
+ */
+
+static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
+
+static const uint32_t kBaudrates[] = {
+    115200, 230400, 460800, 921600, 1500000, 3000000,
+};
+
+static const size_t kPayloadSizes[] = {16, 256, 1024};
+
+/**
+ * Largest payload run in simulation; the bigger ones take too long there.
+ */
+static const size_t kPayloadMaxSizeSim = 16;
+
+static const dif_plic_irq_id_t kUartIrqs[] = {
+    kTopAthosPlicIrqIdUart0TxWatermark,
+    kTopAthosPlicIrqIdUart0RxWatermark,
+    kTopAthosPlicIrqIdUart0TxEmpty,
+};
+
+typedef enum bench_mode {
+  kBenchModePolled,
+  kBenchModeBurst,
+  kBenchModeIrq,
+  kBenchModeCount,
+} bench_mode_t;
+
+static const char *const kBenchModeNames[kBenchModeCount] = {
+    [kBenchModePolled] = "polled",
+    [kBenchModeBurst] = "burst",
+    [kBenchModeIrq] = "irq",
+};
+
+enum {
+  kMaxPayloadBytes = 1024,
+  kRingBytes = 256,
+};
+
+static dif_plic_t plic0;
+static dif_uart_t uart0;
+static uart_irq_engine_t engine;
+
+static uint8_t tx_ring[kRingBytes];
+static uint8_t rx_ring[kRingBytes];
+
+static uint8_t send_data[kMaxPayloadBytes];
+static uint8_t recv_data[kMaxPayloadBytes];
+
+/**
+ * External interrupt handler
+ *
+ * Hands every UART0 interrupt to the engine.
+ */
+void handler_irq_external(void) {
+  // Claim the IRQ by reading the Ibex specific CC register.
+  dif_plic_irq_id_t interrupt_id;
+  CHECK(dif_plic_irq_claim(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
+        "ISR is not implemented!");
+
+  // Check if the interrupted peripheral is UART.
+  top_athos_plic_peripheral_t peripheral_id =
+      top_athos_plic_interrupt_for_peripheral[interrupt_id];
+  CHECK(peripheral_id == kTopAthosPlicPeripheralUart0,
+        "ISR interrupted peripheral is not UART!");
+
+  // PLIC IRQ IDs of a UART instance are laid out in `dif_uart_irq_t` order.
+  uart_irq_engine_handle_irq(
+      &engine,
+      (dif_uart_irq_t)(interrupt_id - kTopAthosPlicIrqIdUart0TxWatermark));
+
+  // Complete the IRQ by writing the IRQ source to the Ibex specific CC
+  // register.
+  CHECK(dif_plic_irq_complete(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
+        "Unable to complete the IRQ request!");
+}
+
+static void plic_configure_irqs(dif_plic_t *plic) {
+  for (int i = 0; i < ARRAYSIZE(kUartIrqs); ++i) {
+    CHECK(dif_plic_irq_set_trigger(plic, kUartIrqs[i],
+                                   kDifPlicIrqTriggerLevel) == kDifPlicOk,
+          "trigger type set failed!");
+    CHECK(dif_plic_irq_set_priority(plic, kUartIrqs[i], kDifPlicMaxPriority) ==
+              kDifPlicOk,
+          "priority set failed!");
+    CHECK(dif_plic_irq_set_enabled(plic, kUartIrqs[i], kPlicTarget,
+                                   kDifPlicToggleEnabled) == kDifPlicOk,
+          "interrupt Enable failed!");
+  }
+
+  // Set Ibex IRQ priority threshold level
+  CHECK(dif_plic_target_set_threshold(plic, kPlicTarget,
+                                      kDifPlicMinPriority) == kDifPlicOk,
+        "threshold set failed!");
+}
+
+static void wait_tx_idle(void) {
+  while (!mmio_region_get_bit32(uart0.params.base_addr, UART_STATUS_REG_OFFSET,
+                                UART_STATUS_TXIDLE_BIT)) {
+  }
+}
+
+/**
+ * Reconfigures UART0 for one run, once it has sent everything already in its
+ * TX FIFO, such as the last result line.
+ *
+ * @return False if `baudrate` cannot be generated from the peripheral clock.
+ */
+static bool uart_setup(uint32_t baudrate, dif_uart_loopback_t loopback,
+                       bool enable_loopback) {
+  wait_tx_idle();
+
+  dif_uart_irq_snapshot_t snapshot;
+  CHECK(dif_uart_irq_disable_all(&uart0, &snapshot) == kDifUartOk);
+
+  dif_uart_config_result_t result =
+      dif_uart_configure(&uart0, (dif_uart_config_t){
+                                     .baudrate = baudrate,
+                                     .clk_freq_hz = kClockFreqPeripheralHz,
+                                     .parity_enable = kDifUartToggleDisabled,
+                                     .parity = kDifUartParityEven,
+                                 });
+  if (result == kDifUartConfigBadNco) {
+    return false;
+  }
+  CHECK(result == kDifUartConfigOk, "UART config failed!");
+
+  CHECK(dif_uart_loopback_set(&uart0, kDifUartLoopbackSystem,
+                              kDifUartToggleDisabled) == kDifUartOk);
+  CHECK(dif_uart_loopback_set(&uart0, kDifUartLoopbackLine,
+                              kDifUartToggleDisabled) == kDifUartOk);
+  if (enable_loopback) {
+    CHECK(dif_uart_loopback_set(&uart0, loopback, kDifUartToggleEnabled) ==
+          kDifUartOk);
+  }
+  CHECK(dif_uart_fifo_reset(&uart0, kDifUartFifoResetAll) == kDifUartOk);
+
+  return true;
+}
+
+/**
+ * Transmits `len` bytes, and receives them back if `receive` is set.
+ *
+ * @return The number of CPU cycles taken.
+ */
+static uint64_t run_transfer(bench_mode_t mode, size_t len, bool receive) {
+  size_t sent = 0;
+  size_t received = receive ? 0 : len;
+
+  if (mode == kBenchModeIrq) {
+    uart_irq_engine_init(&engine, &uart0, tx_ring, sizeof(tx_ring), rx_ring,
+                         sizeof(rx_ring));
+  }
+
+  uint64_t start = ibex_mcycle_read();
+  switch (mode) {
+    case kBenchModePolled:
+      for (; sent < len; ++sent) {
+        CHECK(dif_uart_byte_send_polled(&uart0, send_data[sent]) ==
+              kDifUartOk);
+        if (receive) {
+          CHECK(dif_uart_byte_receive_polled(&uart0, &recv_data[sent]) ==
+                kDifUartOk);
+        }
+      }
+      break;
+    case kBenchModeBurst:
+      while (sent < len || received < len) {
+        size_t count;
+        CHECK(uart_burst_fill(&uart0, &send_data[sent], len - sent, &count) ==
+              kDifUartOk);
+        sent += count;
+        CHECK(uart_burst_drain(&uart0, len - received, &recv_data[received],
+                               &count) == kDifUartOk);
+        received += count;
+      }
+      break;
+    case kBenchModeIrq:
+      while (sent < len || received < len) {
+        sent += uart_irq_engine_write(&engine, &send_data[sent], len - sent);
+        received += uart_irq_engine_read(&engine, &recv_data[received],
+                                         len - received);
+      }
+      break;
+    default:
+      CHECK(false, "Unknown benchmark mode %d", mode);
+  }
+  if (!receive) {
+    wait_tx_idle();
+  }
+  uint64_t cycles = ibex_mcycle_read() - start;
+
+  if (receive) {
+    for (size_t i = 0; i < len; ++i) {
+      CHECK(recv_data[i] == send_data[i], "byte %d: sent 0x%x, received 0x%x",
+            i, send_data[i], recv_data[i]);
+      recv_data[i] = 0;
+    }
+  }
+
+  return cycles;
+}
+
+static void run_benchmark(uint32_t baudrate, dif_uart_loopback_t loopback,
+                          bench_mode_t mode, size_t len) {
+  const char *loopback_name =
+      loopback == kDifUartLoopbackSystem ? "system" : "line";
+
+  if (!uart_setup(baudrate, loopback, true)) {
+    CHECK(uart_setup(kUartBaudrate, kDifUartLoopbackSystem, false));
+    LOG_INFO("BENCH uart baud=%u loopback=%s mode=%s status=unsupported",
+             baudrate, loopback_name, kBenchModeNames[mode]);
+    return;
+  }
+
+  uint64_t cycles =
+      run_transfer(mode, len, loopback == kDifUartLoopbackSystem);
+
+  // Restore the console before reporting.
+  CHECK(uart_setup(kUartBaudrate, kDifUartLoopbackSystem, false));
+  LOG_INFO("BENCH uart baud=%u loopback=%s mode=%s bytes=%u cycles=%u",
+           baudrate, loopback_name, kBenchModeNames[mode], len,
+           (uint32_t)cycles);
+}
+
+const test_config_t kTestConfig = {
+    .can_clobber_uart = true,
+};
+
+bool test_main(void) {
+  LOG_INFO("Running uart benchmark");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+
+  for (size_t i = 0; i < ARRAYSIZE(send_data); ++i) {
+    send_data[i] = (uint8_t)(i * 13 + 5);
+  }
+
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
+            },
+            &uart0) == kDifUartOk);
+  CHECK(dif_plic_init(
+            (dif_plic_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR),
+            },
+            &plic0) == kDifPlicOk,
+        "PLIC init failed!");
+  plic_configure_irqs(&plic0);
+
+  // Enable IRQs on Ibex
+  irq_global_ctrl(true);
+  irq_external_ctrl(true);
+
+  static const dif_uart_loopback_t kLoopbacks[] = {kDifUartLoopbackSystem,
+                                                   kDifUartLoopbackLine};
+  for (int b = 0; b < ARRAYSIZE(kBaudrates); ++b) {
+    for (int s = 0; s < ARRAYSIZE(kPayloadSizes); ++s) {
+      if (is_sim && kPayloadSizes[s] > kPayloadMaxSizeSim) {
+        break;
+      }
+      for (int l = 0; l < ARRAYSIZE(kLoopbacks); ++l) {
+        for (bench_mode_t mode = 0; mode < kBenchModeCount; ++mode) {
+          run_benchmark(kBaudrates[b], kLoopbacks[l], mode, kPayloadSizes[s]);
+        }
+      }
+    }
+  }
+
+  LOG_INFO("Completed Running uart benchmark");
+
+  return true;
+}
@@ -0,0 +1,252 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_uart.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/dif_plic.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "uart_irq_engine.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
+
+/**
+ * UART interrupts serviced by the engine.
+ */
+static const dif_plic_irq_id_t kUartIrqs[] = {
+    kTopAthosPlicIrqIdUart0TxWatermark,
+    kTopAthosPlicIrqIdUart0RxWatermark,
+    kTopAthosPlicIrqIdUart0TxEmpty,
+};
+
+enum {
+  kMaxPayloadBytes = 1024,
+  kRingBytes = 256,
+};
+
+static dif_plic_t plic0;
+static dif_uart_t uart0;
+static uart_irq_engine_t engine;
+
+static uint8_t tx_ring[kRingBytes];
+static uint8_t rx_ring[kRingBytes];
+
+static uint8_t send_data[kMaxPayloadBytes];
+static uint8_t recv_data[kMaxPayloadBytes];
+
+/**
+ * Results, kept until loopback is off and they can be logged.
+ */
+static uint64_t polled_cycles;
+static uint64_t irq_cycles;
+static uint32_t idle_loops;
+
+/**
+ * External interrupt handler
+ *
+ * Hands every UART0 interrupt to the engine.
+ */
+void handler_irq_external(void) {
+  // Claim the IRQ by reading the Ibex specific CC register.
+  dif_plic_irq_id_t interrupt_id;
+  CHECK(dif_plic_irq_claim(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
+        "ISR is not implemented!");
+
+  // Check if the interrupted peripheral is UART.
+  top_athos_plic_peripheral_t peripheral_id =
+      top_athos_plic_interrupt_for_peripheral[interrupt_id];
+  CHECK(peripheral_id == kTopAthosPlicPeripheralUart0,
+        "ISR interrupted peripheral is not UART!");
+
+  // PLIC IRQ IDs of a UART instance are laid out in `dif_uart_irq_t` order.
+  uart_irq_engine_handle_irq(
+      &engine,
+      (dif_uart_irq_t)(interrupt_id - kTopAthosPlicIrqIdUart0TxWatermark));
+
+  // Complete the IRQ by writing the IRQ source to the Ibex specific CC
+  // register.
+  CHECK(dif_plic_irq_complete(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
+        "Unable to complete the IRQ request!");
+}
+
+static void uart_initialise(mmio_region_t base_addr, dif_uart_t *uart) {
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = base_addr,
+            },
+            uart) == kDifUartOk);
+  CHECK(dif_uart_configure(uart,
+                           (dif_uart_config_t){
+                               .baudrate = kUartBaudrate,
+                               .clk_freq_hz = kClockFreqPeripheralHz,
+                               .parity_enable = kDifUartToggleDisabled,
+                               .parity = kDifUartParityEven,
+                           }) == kDifUartConfigOk,
+        "UART config failed!");
+  CHECK(dif_uart_loopback_set(uart, kDifUartLoopbackSystem,
+                              kDifUartToggleEnabled) == kDifUartOk);
+  CHECK(dif_uart_fifo_reset(uart, kDifUartFifoResetAll) == kDifUartOk);
+}
+
+static void plic_initialise(mmio_region_t base_addr, dif_plic_t *plic) {
+  CHECK(dif_plic_init((dif_plic_params_t){.base_addr = base_addr}, plic) ==
+            kDifPlicOk,
+        "PLIC init failed!");
+}
+
+/**
+ * Configures the engine's UART interrupts in PLIC.
+ */
+static void plic_configure_irqs(dif_plic_t *plic) {
+  for (int i = 0; i < ARRAYSIZE(kUartIrqs); ++i) {
+    CHECK(dif_plic_irq_set_trigger(plic, kUartIrqs[i],
+                                   kDifPlicIrqTriggerLevel) == kDifPlicOk,
+          "trigger type set failed!");
+    CHECK(dif_plic_irq_set_priority(plic, kUartIrqs[i], kDifPlicMaxPriority) ==
+              kDifPlicOk,
+          "priority set failed!");
+    CHECK(dif_plic_irq_set_enabled(plic, kUartIrqs[i], kPlicTarget,
+                                   kDifPlicToggleEnabled) == kDifPlicOk,
+          "interrupt Enable failed!");
+  }
+
+  // Set Ibex IRQ priority threshold level
+  CHECK(dif_plic_target_set_threshold(plic, kPlicTarget,
+                                      kDifPlicMinPriority) == kDifPlicOk,
+        "threshold set failed!");
+}
+
+/**
+ * Disables the UART interrupts serviced by the engine.
+ */
+static void uart_irqs_disable(const dif_uart_t *uart) {
+  static const dif_uart_irq_t kIrqs[] = {
+      kDifUartIrqTxWatermark,
+      kDifUartIrqRxWatermark,
+      kDifUartIrqTxEmpty,
+  };
+  for (int i = 0; i < ARRAYSIZE(kIrqs); ++i) {
+    CHECK(dif_uart_irq_set_enabled(uart, kIrqs[i], kDifUartToggleDisabled) ==
+          kDifUartOk);
+  }
+}
+
+/**
+ * Logs the throughput of one transfer, as bytes per million CPU cycles.
+ */
+static void report(const char *mode, size_t bytes, uint64_t cycles) {
+  LOG_INFO("%s: %d bytes in %d cycles, %d bytes/Mcycle", mode, bytes,
+           (uint32_t)cycles, (uint32_t)((bytes * 1000000ull) / cycles));
+}
+
+/**
+ * Loopback through the per-byte polled DIF path.
+ */
+static uint64_t loopback_polled(size_t len) {
+  uint64_t start = ibex_mcycle_read();
+  for (size_t i = 0; i < len; ++i) {
+    CHECK(dif_uart_byte_send_polled(&uart0, send_data[i]) == kDifUartOk);
+    CHECK(dif_uart_byte_receive_polled(&uart0, &recv_data[i]) == kDifUartOk);
+  }
+  return ibex_mcycle_read() - start;
+}
+
+/**
+ * Loopback through the interrupt driven engine.
+ *
+ * The main loop only tops up the TX ring and empties the RX ring; the FIFOs
+ * are serviced from the ISR. `idle_loops` counts main loop iterations, as a
+ * measure of how much of the CPU stays available during the transfer.
+ */
+static uint64_t loopback_irq(size_t len, uint32_t *idle_loops) {
+  size_t sent = 0;
+  size_t received = 0;
+  *idle_loops = 0;
+
+  uint64_t start = ibex_mcycle_read();
+  while (received < len) {
+    if (sent < len) {
+      sent += uart_irq_engine_write(&engine, &send_data[sent], len - sent);
+    }
+    received +=
+        uart_irq_engine_read(&engine, &recv_data[received], len - received);
+    ++*idle_loops;
+  }
+  return ibex_mcycle_read() - start;
+}
+
+static void check_received(size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    CHECK(recv_data[i] == send_data[i], "byte %d: sent 0x%x, received 0x%x",
+          i, send_data[i], recv_data[i]);
+    recv_data[i] = 0;
+  }
+}
+
+const test_config_t kTestConfig = {
+    .can_clobber_uart = true,
+};
+
+bool test_main(void) {
+  LOG_INFO("Running uart IRQ throughput test");
+
+  // Simulations are orders of magnitude slower than the FPGA, keep the
+  // payload small there.
+  size_t len =
+      (kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator)
+          ? 64
+          : kMaxPayloadBytes;
+  for (size_t i = 0; i < len; ++i) {
+    send_data[i] = (uint8_t)(i * 7 + 3);
+  }
+
+  // No debug output in case of UART initialisation failure.
+  mmio_region_t uart_base_addr =
+      mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR);
+  uart_initialise(uart_base_addr, &uart0);
+
+  mmio_region_t plic_base_addr =
+      mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR);
+  plic_initialise(plic_base_addr, &plic0);
+
+  // Polled reference, with all UART interrupts still disabled.
+  polled_cycles = loopback_polled(len);
+  check_received(len);
+
+  uart_irq_engine_init(&engine, &uart0, tx_ring, sizeof(tx_ring), rx_ring,
+                       sizeof(rx_ring));
+  plic_configure_irqs(&plic0);
+
+  // Enable IRQs on Ibex
+  irq_global_ctrl(true);
+  irq_external_ctrl(true);
+
+  irq_cycles = loopback_irq(len, &idle_loops);
+  check_received(len);
+  CHECK(engine.rx_dropped == 0, "RX ring overflowed, %d bytes lost",
+        engine.rx_dropped);
+
+  // Logging over UART0 must neither loop back into its RX FIFO nor wake up
+  // the engine.
+  uart_irqs_disable(&uart0);
+  CHECK(dif_uart_loopback_set(&uart0, kDifUartLoopbackSystem,
+                              kDifUartToggleDisabled) == kDifUartOk);
+  report("polled", len, polled_cycles);
+  report("irq", len, irq_cycles);
+  LOG_INFO("irq: %d UART IRQs, %d main loop iterations", engine.irq_count,
+           idle_loops);
+
+  LOG_INFO("Completed Running uart IRQ throughput test");
+
+  return true;
+}
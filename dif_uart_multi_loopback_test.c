@@ -0,0 +1,218 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_uart.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/dif_plic.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "crc32.h"
+#include "uart_multi.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * Concurrent multi-UART loopback test.
+ *
+ * Runs system loopback on every UART instance of the top at the same time,
+ * interleaved from a single event loop, with all UART interrupts serviced by
+ * one shared handler. Reports the per-port and the aggregate throughput the
+ * hart sustains.
+ */
+
+static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
+
+enum {
+  kPortBytes = 1024,
+  /**
+   * Bytes per port in simulation; the full transfer takes too long there.
+   */
+  kPortBytesSim = 64,
+  /**
+   * Bytes generated, or collected, per port and event loop iteration.
+   */
+  kChunkBytes = 32,
+};
+
+/**
+ * Progress of the transfer on one port.
+ */
+typedef struct port_transfer {
+  uint32_t pattern;
+  size_t sent;
+  size_t received;
+  uint8_t tx_chunk[kChunkBytes];
+  size_t tx_chunk_len;
+  size_t tx_chunk_pos;
+  uint32_t tx_crc;
+  uint32_t rx_crc;
+  uint64_t done_cycles;
+} port_transfer_t;
+
+static dif_plic_t plic0;
+
+static port_transfer_t transfers[kUartMultiMaxPorts];
+
+/**
+ * External interrupt handler
+ *
+ * Hands every UART interrupt to the engine of its port.
+ */
+void handler_irq_external(void) {
+  // Claim the IRQ by reading the Ibex specific CC register.
+  dif_plic_irq_id_t interrupt_id;
+  CHECK(dif_plic_irq_claim(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
+        "ISR is not implemented!");
+
+  CHECK(uart_multi_handle_irq(interrupt_id),
+        "ISR interrupted peripheral is not UART!");
+
+  // Complete the IRQ by writing the IRQ source to the Ibex specific CC
+  // register.
+  CHECK(dif_plic_irq_complete(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
+        "Unable to complete the IRQ request!");
+}
+
+/**
+ * Fills `data` with the next `len` bytes of the xorshift32 sequence.
+ */
+static void pattern_next(uint32_t *state, uint8_t *data, size_t len) {
+  uint32_t x = *state;
+  for (size_t i = 0; i < len; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    data[i] = (uint8_t)x;
+  }
+  *state = x;
+}
+
+/**
+ * Moves one chunk each way between `transfer` and the engine of `port`.
+ */
+static void port_step(uart_multi_port_t *port, port_transfer_t *transfer,
+                      size_t len) {
+  if (transfer->tx_chunk_pos == transfer->tx_chunk_len &&
+      transfer->sent < len) {
+    size_t chunk = len - transfer->sent;
+    transfer->tx_chunk_len = chunk < kChunkBytes ? chunk : kChunkBytes;
+    transfer->tx_chunk_pos = 0;
+    pattern_next(&transfer->pattern, transfer->tx_chunk,
+                 transfer->tx_chunk_len);
+    transfer->tx_crc = crc32_update(transfer->tx_crc, transfer->tx_chunk,
+                                    transfer->tx_chunk_len);
+  }
+  if (transfer->tx_chunk_pos < transfer->tx_chunk_len) {
+    size_t written = uart_irq_engine_write(
+        &port->engine, &transfer->tx_chunk[transfer->tx_chunk_pos],
+        transfer->tx_chunk_len - transfer->tx_chunk_pos);
+    transfer->tx_chunk_pos += written;
+    transfer->sent += written;
+  }
+
+  uint8_t rx_chunk[kChunkBytes];
+  size_t read = uart_irq_engine_read(&port->engine, rx_chunk, sizeof(rx_chunk));
+  transfer->rx_crc = crc32_update(transfer->rx_crc, rx_chunk, read);
+  transfer->received += read;
+}
+
+const test_config_t kTestConfig = {
+    .can_clobber_uart = true,
+};
+
+bool test_main(void) {
+  LOG_INFO("Running multi uart loopback test");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+  size_t len = is_sim ? kPortBytesSim : kPortBytes;
+  size_t port_count = uart_multi_port_count();
+
+  CHECK(dif_plic_init(
+            (dif_plic_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR),
+            },
+            &plic0) == kDifPlicOk,
+        "PLIC init failed!");
+  uart_multi_init(&plic0, kPlicTarget,
+                  (dif_uart_config_t){
+                      .baudrate = kUartBaudrate,
+                      .clk_freq_hz = kClockFreqPeripheralHz,
+                      .parity_enable = kDifUartToggleDisabled,
+                      .parity = kDifUartParityEven,
+                  });
+  for (size_t i = 0; i < port_count; ++i) {
+    CHECK(dif_uart_loopback_set(&uart_multi_port(i)->uart,
+                                kDifUartLoopbackSystem,
+                                kDifUartToggleEnabled) == kDifUartOk);
+  }
+
+  // Set Ibex IRQ priority threshold level
+  CHECK(dif_plic_target_set_threshold(&plic0, kPlicTarget,
+                                      kDifPlicMinPriority) == kDifPlicOk,
+        "threshold set failed!");
+
+  for (size_t i = 0; i < port_count; ++i) {
+    transfers[i] = (port_transfer_t){
+        .pattern = 0x9e3779b9u * (i + 1),
+        .tx_crc = crc32_init(),
+        .rx_crc = crc32_init(),
+    };
+  }
+
+  // Enable IRQs on Ibex
+  irq_global_ctrl(true);
+  irq_external_ctrl(true);
+
+  uint64_t start = ibex_mcycle_read();
+  size_t ports_done = 0;
+  while (ports_done < port_count) {
+    for (size_t i = 0; i < port_count; ++i) {
+      port_transfer_t *transfer = &transfers[i];
+      if (transfer->received == len) {
+        continue;
+      }
+      port_step(uart_multi_port(i), transfer, len);
+      if (transfer->received == len) {
+        transfer->done_cycles = ibex_mcycle_read() - start;
+        ++ports_done;
+      }
+    }
+  }
+  uint64_t cycles = ibex_mcycle_read() - start;
+
+  // Stop the engines and restore the console before reporting.
+  irq_external_ctrl(false);
+  for (size_t i = 0; i < port_count; ++i) {
+    CHECK(dif_uart_loopback_set(&uart_multi_port(i)->uart,
+                                kDifUartLoopbackSystem,
+                                kDifUartToggleDisabled) == kDifUartOk);
+  }
+
+  for (size_t i = 0; i < port_count; ++i) {
+    port_transfer_t *transfer = &transfers[i];
+    uart_multi_port_t *port = uart_multi_port(i);
+    CHECK(crc32_finish(transfer->rx_crc) == crc32_finish(transfer->tx_crc),
+          "port %d: RX CRC 0x%x, TX CRC 0x%x", i,
+          crc32_finish(transfer->rx_crc), crc32_finish(transfer->tx_crc));
+    CHECK(port->engine.rx_dropped == 0, "port %d: %d bytes lost", i,
+          port->engine.rx_dropped);
+    LOG_INFO("port %d: %d bytes in %d cycles, %d UART IRQs", i, len,
+             (uint32_t)transfer->done_cycles, port->engine.irq_count);
+  }
+  LOG_INFO("aggregate: %d ports, %d bytes in %d cycles, %d bytes/Mcycle",
+           port_count, port_count * len, (uint32_t)cycles,
+           (uint32_t)(port_count * len * 1000000ull / cycles));
+
+  LOG_INFO("Completed Running multi uart loopback test");
+
+  return true;
+}
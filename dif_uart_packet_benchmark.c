@@ -0,0 +1,276 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_uart.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/dif_plic.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "uart_burst.h"
+#include "uart_stream.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * UART packet reception benchmark.
+ *
+ * Receives a train of variable length packets over system loopback and
+ * reports the interrupts taken and the CPU cycles spent in the ISR per packet,
+ * one line per run:
+ *
+ *   BENCH uart_packet mode=<byte|packet> bytes=<u> packets=<u>
+ *         irqs_per_packet=<u> isr_cycles_per_packet=<u>
+ *
+ * (on a single line). `byte` is the baseline of an RX watermark of one byte,
+ * i.e. an interrupt per received byte; `packet` drains bulk data on the RX
+ * watermark and ends each packet on the RX timeout.
+ */
+
+static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
+
+static const dif_plic_irq_id_t kUartIrqs[] = {
+    kTopAthosPlicIrqIdUart0RxWatermark,
+    kTopAthosPlicIrqIdUart0RxTimeout,
+};
+
+static const size_t kPacketSizes[] = {1, 4, 16, 64, 256};
+
+/**
+ * Largest packet run in simulation; the bigger ones take too long there.
+ */
+static const size_t kPacketMaxSizeSim = 16;
+
+/**
+ * Packets received per run.
+ */
+static const uint32_t kPacketCount = 8;
+
+/**
+ * Idle time that separates two packets: two characters of 10 bits.
+ */
+static const uint32_t kRxTimeoutBits = 20;
+
+typedef enum bench_mode {
+  kBenchModeByte,
+  kBenchModePacket,
+  kBenchModeCount,
+} bench_mode_t;
+
+static const char *const kBenchModeNames[kBenchModeCount] = {
+    [kBenchModeByte] = "byte",
+    [kBenchModePacket] = "packet",
+};
+
+enum {
+  kMaxPacketBytes = 256,
+};
+
+static dif_plic_t plic0;
+static dif_uart_t uart0;
+static uart_stream_rx_t stream;
+
+static uint8_t send_data[kMaxPacketBytes];
+/**
+ * One byte larger than any packet, so that in packet mode the buffer is only
+ * ever ended by the RX timeout.
+ */
+static uint8_t recv_data[kMaxPacketBytes + 1];
+
+static volatile uint32_t packets_done;
+static volatile size_t packet_len;
+static volatile uint64_t isr_cycles;
+
+/**
+ * External interrupt handler
+ *
+ * Hands every UART0 interrupt to the stream, and accounts for the cycles
+ * spent doing so.
+ */
+void handler_irq_external(void) {
+  uint64_t start = ibex_mcycle_read();
+
+  // Claim the IRQ by reading the Ibex specific CC register.
+  dif_plic_irq_id_t interrupt_id;
+  CHECK(dif_plic_irq_claim(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
+        "ISR is not implemented!");
+
+  // Check if the interrupted peripheral is UART.
+  top_athos_plic_peripheral_t peripheral_id =
+      top_athos_plic_interrupt_for_peripheral[interrupt_id];
+  CHECK(peripheral_id == kTopAthosPlicPeripheralUart0,
+        "ISR interrupted peripheral is not UART!");
+
+  // PLIC IRQ IDs of a UART instance are laid out in `dif_uart_irq_t` order.
+  uart_stream_rx_handle_irq(
+      &stream,
+      (dif_uart_irq_t)(interrupt_id - kTopAthosPlicIrqIdUart0TxWatermark));
+
+  // Complete the IRQ by writing the IRQ source to the Ibex specific CC
+  // register.
+  CHECK(dif_plic_irq_complete(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
+        "Unable to complete the IRQ request!");
+
+  isr_cycles += ibex_mcycle_read() - start;
+}
+
+/**
+ * Stream callback; called once per packet.
+ */
+static void on_packet(void *ctx, uint8_t *data, size_t len) {
+  packet_len = len;
+  ++packets_done;
+}
+
+static void plic_configure_irqs(dif_plic_t *plic) {
+  for (int i = 0; i < ARRAYSIZE(kUartIrqs); ++i) {
+    CHECK(dif_plic_irq_set_trigger(plic, kUartIrqs[i],
+                                   kDifPlicIrqTriggerLevel) == kDifPlicOk,
+          "trigger type set failed!");
+    CHECK(dif_plic_irq_set_priority(plic, kUartIrqs[i], kDifPlicMaxPriority) ==
+              kDifPlicOk,
+          "priority set failed!");
+    CHECK(dif_plic_irq_set_enabled(plic, kUartIrqs[i], kPlicTarget,
+                                   kDifPlicToggleEnabled) == kDifPlicOk,
+          "interrupt Enable failed!");
+  }
+
+  // Set Ibex IRQ priority threshold level
+  CHECK(dif_plic_target_set_threshold(plic, kPlicTarget,
+                                      kDifPlicMinPriority) == kDifPlicOk,
+        "threshold set failed!");
+}
+
+/**
+ * Cost of one run, per packet.
+ */
+typedef struct bench_result {
+  uint32_t irqs;
+  uint32_t isr_cycles;
+} bench_result_t;
+
+/**
+ * Results are only logged once all runs are done, as the console output would
+ * otherwise be looped back into the stream.
+ */
+static bench_result_t results[ARRAYSIZE(kPacketSizes)][kBenchModeCount];
+
+/**
+ * Receives `kPacketCount` packets of `len` bytes.
+ */
+static bench_result_t run_benchmark(bench_mode_t mode, size_t len) {
+  uart_stream_rx_init(&stream, &uart0, kRxTimeoutBits, on_packet, NULL);
+  if (mode == kBenchModeByte) {
+    // An interrupt per received byte; the buffer has the size of the packet,
+    // so it completes with the last byte.
+    CHECK(dif_uart_watermark_rx_set(&uart0, kDifUartWatermarkRxByte1) ==
+          kDifUartOk);
+  } else {
+    uart_stream_rx_set_packet_mode(&stream, true);
+  }
+  packets_done = 0;
+  isr_cycles = 0;
+
+  for (uint32_t i = 0; i < kPacketCount; ++i) {
+    // In packet mode the buffer is only filled up to the packet length.
+    size_t buffer_size = mode == kBenchModePacket ? sizeof(recv_data) : len;
+    CHECK(uart_stream_rx_submit(&stream, recv_data, buffer_size));
+
+    send_data[0] = (uint8_t)i;
+    CHECK(uart_burst_send(&uart0, send_data, len) == kDifUartOk);
+    while (packets_done == i) {
+    }
+
+    CHECK(packet_len == len, "packet %d: received %d bytes, expected %d", i,
+          packet_len, len);
+    for (size_t j = 0; j < len; ++j) {
+      CHECK(recv_data[j] == send_data[j], "packet %d byte %d: 0x%x != 0x%x",
+            i, j, recv_data[j], send_data[j]);
+      recv_data[j] = 0;
+    }
+  }
+
+  uart_stream_rx_stop(&stream);
+
+  return (bench_result_t){
+      .irqs = stream.irq_count / kPacketCount,
+      .isr_cycles = (uint32_t)(isr_cycles / kPacketCount),
+  };
+}
+
+const test_config_t kTestConfig = {
+    .can_clobber_uart = true,
+};
+
+bool test_main(void) {
+  LOG_INFO("Running uart packet benchmark");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+
+  for (size_t i = 0; i < ARRAYSIZE(send_data); ++i) {
+    send_data[i] = (uint8_t)(i * 31 + 3);
+  }
+
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
+            },
+            &uart0) == kDifUartOk);
+  CHECK(dif_uart_configure(&uart0,
+                           (dif_uart_config_t){
+                               .baudrate = kUartBaudrate,
+                               .clk_freq_hz = kClockFreqPeripheralHz,
+                               .parity_enable = kDifUartToggleDisabled,
+                               .parity = kDifUartParityEven,
+                           }) == kDifUartConfigOk,
+        "UART config failed!");
+  CHECK(dif_uart_loopback_set(&uart0, kDifUartLoopbackSystem,
+                              kDifUartToggleEnabled) == kDifUartOk);
+  CHECK(dif_uart_fifo_reset(&uart0, kDifUartFifoResetAll) == kDifUartOk);
+
+  CHECK(dif_plic_init(
+            (dif_plic_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR),
+            },
+            &plic0) == kDifPlicOk,
+        "PLIC init failed!");
+  plic_configure_irqs(&plic0);
+
+  // Enable IRQs on Ibex
+  irq_global_ctrl(true);
+  irq_external_ctrl(true);
+
+  size_t sizes = 0;
+  for (; sizes < ARRAYSIZE(kPacketSizes); ++sizes) {
+    if (is_sim && kPacketSizes[sizes] > kPacketMaxSizeSim) {
+      break;
+    }
+    for (bench_mode_t mode = 0; mode < kBenchModeCount; ++mode) {
+      results[sizes][mode] = run_benchmark(mode, kPacketSizes[sizes]);
+    }
+  }
+
+  CHECK(dif_uart_loopback_set(&uart0, kDifUartLoopbackSystem,
+                              kDifUartToggleDisabled) == kDifUartOk);
+  for (size_t s = 0; s < sizes; ++s) {
+    for (bench_mode_t mode = 0; mode < kBenchModeCount; ++mode) {
+      LOG_INFO(
+          "BENCH uart_packet mode=%s bytes=%u packets=%u irqs_per_packet=%u "
+          "isr_cycles_per_packet=%u",
+          kBenchModeNames[mode], kPacketSizes[s], kPacketCount,
+          results[s][mode].irqs, results[s][mode].isr_cycles);
+    }
+  }
+
+  LOG_INFO("Completed Running uart packet benchmark");
+
+  return true;
+}
@@ -0,0 +1,254 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_uart.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "crc32.h"
+#include "uart_burst.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * Pipelined full-duplex loopback test.
+ *
+ * Keeps the TX FIFO topped up while the RX FIFO is drained, so that both
+ * directions run at line rate at the same time. Instead of checking every
+ * byte, a running CRC32 is kept over the transmitted and over the received
+ * stream and the two are compared at the end. An RX overflow, or a stall of
+ * the receive side, ends the run at that baud rate early, and is reported
+ * with the number of bytes received until then. The payload is generated on
+ * the fly, so it is not limited by the size of a buffer.
+ */
+
+static const uint32_t kBaudrates[] = {
+    115200, 230400, 460800, 921600, 1500000, 3000000,
+};
+
+enum {
+  kStreamBytes = 16384,
+  /**
+   * Transfer size in simulation; the full one takes too long there.
+   */
+  kStreamBytesSim = 256,
+  /**
+   * Bytes generated, or drained, at a time; the depth of the UART FIFOs.
+   */
+  kChunkBytes = 32,
+  /**
+   * Bits per character on the line: start, 8 data and stop bit.
+   */
+  kBitsPerChar = 10,
+  /**
+   * Characters' worth of line time without any byte received after which the
+   * receive side is considered stalled.
+   */
+  kStallChars = 64,
+};
+
+/**
+ * Outcome of the run at one baud rate.
+ */
+typedef struct pipelined_result {
+  bool supported;
+  bool overflow;
+  bool stalled;
+  uint32_t received;
+  uint32_t cycles;
+  uint32_t tx_crc;
+  uint32_t rx_crc;
+} pipelined_result_t;
+
+/**
+ * Results are only logged once all runs are done and loopback is off, as the
+ * console output would otherwise be looped back into the RX FIFO.
+ */
+static pipelined_result_t results[ARRAYSIZE(kBaudrates)];
+
+/**
+ * Fills `data` with the next `len` bytes of the xorshift32 sequence.
+ */
+static void pattern_next(uint32_t *state, uint8_t *data, size_t len) {
+  uint32_t x = *state;
+  for (size_t i = 0; i < len; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    data[i] = (uint8_t)x;
+  }
+  *state = x;
+}
+
+/**
+ * Configures `uart` for system loopback at `baudrate`.
+ *
+ * @return False if `baudrate` cannot be generated from the peripheral clock.
+ */
+static bool uart_setup(const dif_uart_t *uart, uint32_t baudrate) {
+  dif_uart_config_result_t result =
+      dif_uart_configure(uart, (dif_uart_config_t){
+                                   .baudrate = baudrate,
+                                   .clk_freq_hz = kClockFreqPeripheralHz,
+                                   .parity_enable = kDifUartToggleDisabled,
+                                   .parity = kDifUartParityEven,
+                               });
+  if (result == kDifUartConfigBadNco) {
+    return false;
+  }
+  CHECK(result == kDifUartConfigOk, "UART config failed!");
+
+  CHECK(dif_uart_loopback_set(uart, kDifUartLoopbackSystem,
+                              kDifUartToggleEnabled) == kDifUartOk);
+  CHECK(dif_uart_fifo_reset(uart, kDifUartFifoResetAll) == kDifUartOk);
+  CHECK(dif_uart_irq_acknowledge(uart, kDifUartIrqRxOverflow) == kDifUartOk);
+
+  return true;
+}
+
+/**
+ * Streams `len` bytes through the loopback at `baudrate`, transmitting and
+ * receiving at the same time.
+ *
+ * Stops early if the RX FIFO overflows, as the dropped bytes would never
+ * arrive, or if nothing is received for `kStallChars` characters.
+ */
+static pipelined_result_t run_pipelined(const dif_uart_t *uart,
+                                        uint32_t baudrate, size_t len) {
+  uint8_t tx_chunk[kChunkBytes];
+  uint8_t rx_chunk[kChunkBytes];
+  size_t tx_chunk_len = 0;
+  size_t tx_chunk_pos = 0;
+  size_t sent = 0;
+  size_t received = 0;
+  uint32_t pattern = 0x12345678;
+  uint32_t tx_crc = crc32_init();
+  uint32_t rx_crc = crc32_init();
+  bool overflow = false;
+  bool stalled = false;
+  uint64_t stall_cycles =
+      (uint64_t)kStallChars * kBitsPerChar * kClockFreqCpuHz / baudrate;
+
+  uint64_t start = ibex_mcycle_read();
+  uint64_t last_progress = start;
+  while (received < len) {
+    if (tx_chunk_pos == tx_chunk_len && sent < len) {
+      tx_chunk_len = len - sent < kChunkBytes ? len - sent : kChunkBytes;
+      tx_chunk_pos = 0;
+      pattern_next(&pattern, tx_chunk, tx_chunk_len);
+      tx_crc = crc32_update(tx_crc, tx_chunk, tx_chunk_len);
+    }
+    if (tx_chunk_pos < tx_chunk_len) {
+      size_t written;
+      CHECK(uart_burst_fill(uart, &tx_chunk[tx_chunk_pos],
+                            tx_chunk_len - tx_chunk_pos,
+                            &written) == kDifUartOk);
+      tx_chunk_pos += written;
+      sent += written;
+    }
+
+    size_t read;
+    CHECK(uart_burst_drain(uart, sizeof(rx_chunk), rx_chunk, &read) ==
+          kDifUartOk);
+    CHECK(received + read <= len, "received %d bytes more than sent",
+          received + read - len);
+    rx_crc = crc32_update(rx_crc, rx_chunk, read);
+    received += read;
+
+    // The overflow state is only read while the RX FIFO is empty, to keep it
+    // off the path that drains it.
+    uint64_t now = ibex_mcycle_read();
+    if (read != 0) {
+      last_progress = now;
+      continue;
+    }
+    CHECK(dif_uart_irq_is_pending(uart, kDifUartIrqRxOverflow, &overflow) ==
+          kDifUartOk);
+    stalled = now - last_progress > stall_cycles;
+    if (overflow || stalled) {
+      break;
+    }
+  }
+  uint64_t cycles = ibex_mcycle_read() - start;
+
+  if (!overflow) {
+    CHECK(dif_uart_irq_is_pending(uart, kDifUartIrqRxOverflow, &overflow) ==
+          kDifUartOk);
+  }
+
+  return (pipelined_result_t){
+      .supported = true,
+      .overflow = overflow,
+      .stalled = stalled,
+      .received = (uint32_t)received,
+      .cycles = (uint32_t)cycles,
+      .tx_crc = crc32_finish(tx_crc),
+      .rx_crc = crc32_finish(rx_crc),
+  };
+}
+
+const test_config_t kTestConfig = {
+    .can_clobber_uart = true,
+};
+
+bool test_main(void) {
+  dif_uart_t uart;
+  LOG_INFO("Running uart pipelined loopback test");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+  size_t len = is_sim ? kStreamBytesSim : kStreamBytes;
+
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
+            },
+            &uart) == kDifUartOk);
+
+  for (int i = 0; i < ARRAYSIZE(kBaudrates); ++i) {
+    if (uart_setup(&uart, kBaudrates[i])) {
+      results[i] = run_pipelined(&uart, kBaudrates[i], len);
+    }
+  }
+
+  // Restore the console.
+  CHECK(uart_setup(&uart, kUartBaudrate));
+  CHECK(dif_uart_loopback_set(&uart, kDifUartLoopbackSystem,
+                              kDifUartToggleDisabled) == kDifUartOk);
+
+  bool passed = true;
+  for (int i = 0; i < ARRAYSIZE(kBaudrates); ++i) {
+    if (!results[i].supported) {
+      LOG_INFO("baud %d: unsupported", kBaudrates[i]);
+      continue;
+    }
+    if (results[i].overflow || results[i].stalled) {
+      LOG_ERROR("baud %d: failed, RX %s after %d of %d bytes", kBaudrates[i],
+                results[i].overflow ? "overflow" : "stall",
+                results[i].received, len);
+      passed = false;
+      continue;
+    }
+
+    // Cycles the transfer would take with the line busy all the time.
+    uint64_t line_cycles =
+        (uint64_t)len * kBitsPerChar * kClockFreqCpuHz / kBaudrates[i];
+    LOG_INFO("baud %d: %d bytes in %d cycles, %d%% of line rate",
+             kBaudrates[i], len, results[i].cycles,
+             (uint32_t)(line_cycles * 100 / results[i].cycles));
+    CHECK(results[i].rx_crc == results[i].tx_crc,
+          "baud %d: RX CRC 0x%x, TX CRC 0x%x", kBaudrates[i],
+          results[i].rx_crc, results[i].tx_crc);
+  }
+  CHECK(passed, "RX overflow or stall at some baud rates");
+
+  LOG_INFO("Completed Running uart pipelined loopback test");
+
+  return true;
+}
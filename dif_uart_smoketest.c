@@ -12,6 +12,7 @@
 #include "dif/hart.h"
 #include "dif/check.h"
 #include "dif/test_main.h"
+#include "profile.h"
 #include "top/sw/autogen/top_athos.h"  // Generated.
 
 static const uint8_t kSendData[] = "Smoke test!";
@@ -26,38 +27,55 @@ const test_config_t kTestConfig = {
 bool test_main(void) {
   dif_uart_t uart;
   LOG_INFO("Running uart smoketest");  
-  CHECK(
-      dif_uart_init(
-          (dif_uart_params_t){
-              .base_addr = mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
-          },
-          &uart) == kDifUartOk);
-  CHECK(dif_uart_configure(&uart,
-                           (dif_uart_config_t){
-                               .baudrate = kUartBaudrate,
-                               .clk_freq_hz = kClockFreqPeripheralHz,
-                               .parity_enable = kDifUartToggleDisabled,
-                               .parity = kDifUartParityEven,
-                           }) == kDifUartConfigOk,
+  profile_init();
+  CHECK(PROFILE_CALL(
+            "dif_uart_init",
+            dif_uart_init(
+                (dif_uart_params_t){
+                    .base_addr =
+                        mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR),
+                },
+                &uart)) == kDifUartOk);
+  CHECK(PROFILE_CALL(
+            "dif_uart_configure",
+            dif_uart_configure(&uart,
+                               (dif_uart_config_t){
+                                   .baudrate = kUartBaudrate,
+                                   .clk_freq_hz = kClockFreqPeripheralHz,
+                                   .parity_enable = kDifUartToggleDisabled,
+                                   .parity = kDifUartParityEven,
+                               })) == kDifUartConfigOk,
         "UART config failed!");
 
-  CHECK(dif_uart_loopback_set(&uart, kDifUartLoopbackSystem,
-                              kDifUartToggleEnabled) == kDifUartOk);
-  CHECK(dif_uart_fifo_reset(&uart, kDifUartFifoResetAll) == kDifUartOk);
+  CHECK(PROFILE_CALL("dif_uart_loopback_set",
+                     dif_uart_loopback_set(&uart, kDifUartLoopbackSystem,
+                                           kDifUartToggleEnabled)) ==
+        kDifUartOk);
+  CHECK(PROFILE_CALL("dif_uart_fifo_reset",
+                     dif_uart_fifo_reset(&uart, kDifUartFifoResetAll)) ==
+        kDifUartOk);
 
   // Send all bytes in `kSendData`, and check that they are received via
   // the loopback mechanism.
   for (int i = 0; i < sizeof(kSendData); ++i) {
-    CHECK(dif_uart_byte_send_polled(&uart, kSendData[i]) == kDifUartOk);
+    CHECK(PROFILE_CALL("dif_uart_byte_send_polled",
+                       dif_uart_byte_send_polled(&uart, kSendData[i])) ==
+          kDifUartOk);
 
     uint8_t receive_byte;
-    CHECK(dif_uart_byte_receive_polled(&uart, &receive_byte) == kDifUartOk);
+    CHECK(PROFILE_CALL("dif_uart_byte_receive_polled",
+                       dif_uart_byte_receive_polled(&uart, &receive_byte)) ==
+          kDifUartOk);
     CHECK(receive_byte == kSendData[i]);
     debugSendData[i] = kSendData[i];
     debugRecvData[i] = receive_byte;
     
   }
 
+  // The statistics are logged over this UART, so not through the loopback.
+  CHECK(dif_uart_loopback_set(&uart, kDifUartLoopbackSystem,
+                              kDifUartToggleDisabled) == kDifUartOk);
+  profile_dump();
   
   LOG_INFO("Completed Running uart smoketest");
 
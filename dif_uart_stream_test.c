@@ -0,0 +1,274 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "dif/dif_uart.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/device.h"
+#include "dif/dif_plic.h"
+#include "dif/handler.h"
+#include "dif/hart.h"
+#include "dif/irq.h"
+#include "dif/log.h"
+#include "dif/check.h"
+#include "dif/test_main.h"
+#include "uart_burst.h"
+#include "uart_stream.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+static const uint32_t kPlicTarget = kTopAthosPlicTargetIbex0;
+
+/**
+ * UART interrupts serviced by the stream.
+ */
+static const dif_plic_irq_id_t kUartIrqs[] = {
+    kTopAthosPlicIrqIdUart0RxWatermark,
+    kTopAthosPlicIrqIdUart0RxTimeout,
+};
+
+/**
+ * RX idle time after which the bytes below the RX watermark are collected:
+ * four characters of 10 bits.
+ */
+static const uint32_t kRxTimeoutBits = 40;
+
+enum {
+  kStreamBytes = 4096,
+  /**
+   * Transfer size in simulation; the full one takes too long there.
+   */
+  kStreamBytesSim = 256,
+};
+
+static dif_plic_t plic0;
+static dif_uart_t uart0;
+static uart_stream_rx_t stream;
+
+static uint8_t send_data[kStreamBytes];
+static uint8_t recv_data[kStreamBytes];
+
+/**
+ * Received data, as seen by the stream callback.
+ */
+typedef struct stream_result {
+  volatile uint32_t buffers;
+  volatile uint32_t chunks;
+  volatile uint32_t bytes;
+  volatile uint32_t checksum;
+  /**
+   * Where the next completed buffer is expected to start.
+   */
+  uint8_t *volatile next_buffer;
+} stream_result_t;
+
+static stream_result_t result;
+
+/**
+ * UART interrupts taken per run; only logged at the end, as the console
+ * output would otherwise be looped back into the stream.
+ */
+static uint32_t buffer_irqs;
+static uint32_t callback_irqs;
+
+/**
+ * External interrupt handler
+ *
+ * Hands every UART0 interrupt to the stream.
+ */
+void handler_irq_external(void) {
+  // Claim the IRQ by reading the Ibex specific CC register.
+  dif_plic_irq_id_t interrupt_id;
+  CHECK(dif_plic_irq_claim(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
+        "ISR is not implemented!");
+
+  // Check if the interrupted peripheral is UART.
+  top_athos_plic_peripheral_t peripheral_id =
+      top_athos_plic_interrupt_for_peripheral[interrupt_id];
+  CHECK(peripheral_id == kTopAthosPlicPeripheralUart0,
+        "ISR interrupted peripheral is not UART!");
+
+  // PLIC IRQ IDs of a UART instance are laid out in `dif_uart_irq_t` order.
+  uart_stream_rx_handle_irq(
+      &stream,
+      (dif_uart_irq_t)(interrupt_id - kTopAthosPlicIrqIdUart0TxWatermark));
+
+  // Complete the IRQ by writing the IRQ source to the Ibex specific CC
+  // register.
+  CHECK(dif_plic_irq_complete(&plic0, kPlicTarget, &interrupt_id) == kDifPlicOk,
+        "Unable to complete the IRQ request!");
+}
+
+/**
+ * Adler-style running checksum, order sensitive so that reordered chunks are
+ * caught as well.
+ */
+static uint32_t checksum_update(uint32_t checksum, const uint8_t *data,
+                                size_t len) {
+  uint32_t a = checksum & 0xffff;
+  uint32_t b = checksum >> 16;
+  for (size_t i = 0; i < len; ++i) {
+    a = (a + data[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+/**
+ * Stream callback for registered buffers; called once per filled buffer.
+ */
+static void on_buffer(void *ctx, uint8_t *data, size_t len) {
+  stream_result_t *res = (stream_result_t *)ctx;
+  CHECK(data == res->next_buffer, "buffer %d completed out of order",
+        res->buffers);
+  res->next_buffer = data + len;
+  res->bytes += len;
+  ++res->buffers;
+}
+
+/**
+ * Stream callback without registered buffers; consumes each chunk in place.
+ */
+static void on_chunk(void *ctx, uint8_t *data, size_t len) {
+  stream_result_t *res = (stream_result_t *)ctx;
+  res->checksum = checksum_update(res->checksum, data, len);
+  res->bytes += len;
+  ++res->chunks;
+}
+
+static void uart_initialise(mmio_region_t base_addr, dif_uart_t *uart) {
+  CHECK(dif_uart_init(
+            (dif_uart_params_t){
+                .base_addr = base_addr,
+            },
+            uart) == kDifUartOk);
+  CHECK(dif_uart_configure(uart,
+                           (dif_uart_config_t){
+                               .baudrate = kUartBaudrate,
+                               .clk_freq_hz = kClockFreqPeripheralHz,
+                               .parity_enable = kDifUartToggleDisabled,
+                               .parity = kDifUartParityEven,
+                           }) == kDifUartConfigOk,
+        "UART config failed!");
+  CHECK(dif_uart_loopback_set(uart, kDifUartLoopbackSystem,
+                              kDifUartToggleEnabled) == kDifUartOk);
+  CHECK(dif_uart_fifo_reset(uart, kDifUartFifoResetAll) == kDifUartOk);
+}
+
+static void plic_initialise(mmio_region_t base_addr, dif_plic_t *plic) {
+  CHECK(dif_plic_init((dif_plic_params_t){.base_addr = base_addr}, plic) ==
+            kDifPlicOk,
+        "PLIC init failed!");
+}
+
+/**
+ * Configures the stream's UART interrupts in PLIC.
+ */
+static void plic_configure_irqs(dif_plic_t *plic) {
+  for (int i = 0; i < ARRAYSIZE(kUartIrqs); ++i) {
+    CHECK(dif_plic_irq_set_trigger(plic, kUartIrqs[i],
+                                   kDifPlicIrqTriggerLevel) == kDifPlicOk,
+          "trigger type set failed!");
+    CHECK(dif_plic_irq_set_priority(plic, kUartIrqs[i], kDifPlicMaxPriority) ==
+              kDifPlicOk,
+          "priority set failed!");
+    CHECK(dif_plic_irq_set_enabled(plic, kUartIrqs[i], kPlicTarget,
+                                   kDifPlicToggleEnabled) == kDifPlicOk,
+          "interrupt Enable failed!");
+  }
+
+  // Set Ibex IRQ priority threshold level
+  CHECK(dif_plic_target_set_threshold(plic, kPlicTarget,
+                                      kDifPlicMinPriority) == kDifPlicOk,
+        "threshold set failed!");
+}
+
+/**
+ * Receives `len` bytes straight into `recv_data`, registered as four buffers.
+ */
+static void receive_into_buffers(size_t len) {
+  static const size_t kBufferCount = 4;
+  size_t buffer_size = len / kBufferCount;
+
+  result = (stream_result_t){.next_buffer = recv_data};
+  uart_stream_rx_init(&stream, &uart0, kRxTimeoutBits, on_buffer, &result);
+  for (size_t i = 0; i < kBufferCount; ++i) {
+    CHECK(uart_stream_rx_submit(&stream, &recv_data[i * buffer_size],
+                                buffer_size),
+          "buffer %d submit failed!", i);
+  }
+
+  CHECK(uart_burst_send(&uart0, send_data, len) == kDifUartOk);
+  while (result.buffers < kBufferCount) {
+  }
+
+  CHECK(result.bytes == len, "received %d bytes, expected %d", result.bytes,
+        len);
+  for (size_t i = 0; i < len; ++i) {
+    CHECK(recv_data[i] == send_data[i], "byte %d: sent 0x%x, received 0x%x",
+          i, send_data[i], recv_data[i]);
+  }
+  uart_stream_rx_stop(&stream);
+  buffer_irqs = stream.irq_count;
+}
+
+/**
+ * Receives `len` bytes without registering any buffer, checksumming each
+ * chunk as it is drained.
+ */
+static void receive_into_callback(size_t len) {
+  result = (stream_result_t){.checksum = 1};
+  uart_stream_rx_init(&stream, &uart0, kRxTimeoutBits, on_chunk, &result);
+
+  CHECK(uart_burst_send(&uart0, send_data, len) == kDifUartOk);
+  // The tail of the transfer below the RX watermark arrives with the RX
+  // timeout.
+  while (result.bytes < len) {
+  }
+
+  CHECK(result.bytes == len, "received %d bytes, expected %d", result.bytes,
+        len);
+  uint32_t expected = checksum_update(1, send_data, len);
+  CHECK(result.checksum == expected, "checksum 0x%x, expected 0x%x",
+        result.checksum, expected);
+  uart_stream_rx_stop(&stream);
+  callback_irqs = stream.irq_count;
+}
+
+const test_config_t kTestConfig = {
+    .can_clobber_uart = true,
+};
+
+bool test_main(void) {
+  LOG_INFO("Running uart stream test");
+
+  bool is_sim =
+      kDeviceType == kDeviceSimDV || kDeviceType == kDeviceSimVerilator;
+  size_t len = is_sim ? kStreamBytesSim : kStreamBytes;
+
+  for (size_t i = 0; i < ARRAYSIZE(send_data); ++i) {
+    send_data[i] = (uint8_t)(i * 7 + (i >> 8));
+  }
+
+  uart_initialise(mmio_region_from_addr(TOP_ATHOS_UART0_BASE_ADDR), &uart0);
+  plic_initialise(mmio_region_from_addr(TOP_ATHOS_RV_PLIC_BASE_ADDR), &plic0);
+  plic_configure_irqs(&plic0);
+
+  // Enable IRQs on Ibex
+  irq_global_ctrl(true);
+  irq_external_ctrl(true);
+
+  receive_into_buffers(len);
+  receive_into_callback(len);
+
+  CHECK(dif_uart_loopback_set(&uart0, kDifUartLoopbackSystem,
+                              kDifUartToggleDisabled) == kDifUartOk);
+  LOG_INFO("buffers: %d bytes with %d IRQs", len, buffer_irqs);
+  LOG_INFO("callback: %d bytes in %d chunks with %d IRQs", len, result.chunks,
+           callback_irqs);
+
+  LOG_INFO("Completed Running uart stream test");
+
+  return true;
+}
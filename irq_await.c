@@ -0,0 +1,117 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "irq_await.h"
+
+#include "dif/check.h"
+#include "dif/device.h"
+#include "dif/hart.h"
+#include "dif/ibex.h"
+#include "dif/irq.h"
+#include "irq_lock.h"
+#include "rv_timer_tick_params.h"
+
+static const uint64_t kTickFreqHz = 1000 * 1000;  // 1 MHz.
+
+static const dif_rv_timer_t *await_timer;
+static uint32_t await_hart;
+static uint32_t await_comparator;
+
+static volatile bool deadline_expired;
+
+void irq_await_init(const dif_rv_timer_t *timer, uint32_t hart,
+                    uint32_t comparator) {
+  await_timer = timer;
+  await_hart = hart;
+  await_comparator = comparator;
+
+  dif_rv_timer_tick_params_t tick_params;
+  CHECK(rv_timer_tick_params_get(kTickFreqHz, &tick_params) ==
+        kDifRvTimerApproximateTickParamsOk);
+  CHECK(dif_rv_timer_set_tick_params(timer, hart, tick_params) ==
+        kDifRvTimerOk);
+  CHECK(dif_rv_timer_arm(timer, hart, comparator, UINT64_MAX) ==
+        kDifRvTimerOk);
+  CHECK(dif_rv_timer_irq_clear(timer, hart, comparator) == kDifRvTimerOk);
+  CHECK(dif_rv_timer_irq_enable(timer, hart, comparator,
+                                kDifRvTimerEnabled) == kDifRvTimerOk);
+  CHECK(dif_rv_timer_counter_set_enabled(timer, hart, kDifRvTimerEnabled) ==
+        kDifRvTimerOk);
+  irq_timer_ctrl(true);
+}
+
+/**
+ * Arms the deadline `timeout_usec` from now.
+ */
+static void deadline_arm(uint32_t timeout_usec) {
+  CHECK(await_timer != NULL, "irq_await_init() has not been called!");
+  uint64_t now;
+  CHECK(dif_rv_timer_counter_read(await_timer, await_hart, &now) ==
+        kDifRvTimerOk);
+  deadline_expired = false;
+  CHECK(dif_rv_timer_arm(await_timer, await_hart, await_comparator,
+                         now + timeout_usec) == kDifRvTimerOk);
+}
+
+static void deadline_disarm(void) {
+  CHECK(dif_rv_timer_arm(await_timer, await_hart, await_comparator,
+                         UINT64_MAX) == kDifRvTimerOk);
+  CHECK(dif_rv_timer_irq_clear(await_timer, await_hart, await_comparator) ==
+        kDifRvTimerOk);
+}
+
+bool irq_await(irq_await_cond_fn_t cond, void *ctx, uint32_t timeout_usec,
+               uint32_t *cycles) {
+  uint64_t start = ibex_mcycle_read();
+  deadline_arm(timeout_usec);
+
+  bool done;
+  for (;;) {
+    uint32_t irq_state = irq_lock_acquire();
+    done = cond(ctx);
+    if (done || deadline_expired) {
+      irq_lock_release(irq_state);
+      break;
+    }
+    // A pending interrupt ends the WFI even while masked; it is then taken on
+    // release, before `cond` is checked again.
+    wait_for_interrupt();
+    irq_lock_release(irq_state);
+  }
+
+  if (cycles != NULL) {
+    *cycles = (uint32_t)(ibex_mcycle_read() - start);
+  }
+  deadline_disarm();
+  return done;
+}
+
+bool irq_await_poll(irq_await_cond_fn_t cond, void *ctx,
+                    uint32_t timeout_usec, uint32_t *cycles) {
+  uint64_t start = ibex_mcycle_read();
+  deadline_arm(timeout_usec);
+
+  bool done;
+  while (!(done = cond(ctx)) && !deadline_expired) {
+  }
+
+  if (cycles != NULL) {
+    *cycles = (uint32_t)(ibex_mcycle_read() - start);
+  }
+  deadline_disarm();
+  return done;
+}
+
+static bool flag_is_set(void *ctx) { return *(volatile bool *)ctx; }
+
+bool irq_await_flag(volatile bool *flag, uint32_t timeout_usec,
+                    uint32_t *cycles) {
+  return irq_await(flag_is_set, (void *)flag, timeout_usec, cycles);
+}
+
+void irq_await_handle_timer_irq(void) {
+  // Disarm first; the interrupt stays asserted for as long as the counter is
+  // past the deadline.
+  deadline_disarm();
+  deadline_expired = true;
+}
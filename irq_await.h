@@ -0,0 +1,83 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_IRQ_AWAIT_H_
+#define ATHOS_SW_DIF_SMOKETEST_IRQ_AWAIT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dif/dif_rv_timer.h"
+
+/**
+ * Waiting for interrupt driven events, with a timeout.
+ *
+ * Instead of sleeping for a fixed time and then checking whether an event
+ * happened, the waits here return as soon as it does, and fail once the
+ * timeout expires. The timeout is a one-shot deadline on an rv_timer
+ * comparator, so that the hart can sleep in `wait_for_interrupt()` between
+ * interrupts: either the event or the deadline wakes it up.
+ *
+ * The timer interrupt must be routed to `irq_await_handle_timer_irq()`,
+ * typically as the body of `handler_irq_timer()`.
+ */
+
+/**
+ * Condition waited for; evaluated with interrupts masked.
+ *
+ * @param ctx Context passed to the wait.
+ * @return True once the condition holds.
+ */
+typedef bool (*irq_await_cond_fn_t)(void *ctx);
+
+/**
+ * Sets up the timeout deadline on `comparator` of `hart`, and enables the
+ * timer interrupt.
+ *
+ * Sets the tick rate of `hart` to 1 MHz and starts its counter; the timer is
+ * not available to the test for anything else.
+ *
+ * @param timer Initialised rv_timer; must outlive the waits.
+ * @param hart Hart whose counter is used.
+ * @param comparator Comparator of `hart` used for the deadline.
+ */
+void irq_await_init(const dif_rv_timer_t *timer, uint32_t hart,
+                    uint32_t comparator);
+
+/**
+ * Sleeps in `wait_for_interrupt()` until `cond` holds, or `timeout_usec` has
+ * expired.
+ *
+ * `cond` is checked with interrupts masked before every sleep, so that an
+ * interrupt that makes it true between the check and the WFI is not missed;
+ * it still wakes the hart, and is taken once interrupts are unmasked again.
+ * Only use this for conditions that are set by an interrupt handler.
+ *
+ * @param cond Condition to wait for.
+ * @param ctx Passed to `cond`.
+ * @param timeout_usec Timeout in microseconds.
+ * @param[out] cycles Optional; CPU cycles until `cond` held, or timed out.
+ * @return True if `cond` held before the timeout.
+ */
+bool irq_await(irq_await_cond_fn_t cond, void *ctx, uint32_t timeout_usec,
+               uint32_t *cycles);
+
+/**
+ * Like `irq_await()`, but busy-polls `cond` instead of sleeping; for
+ * conditions that do not raise an interrupt, e.g. a peripheral status bit.
+ */
+bool irq_await_poll(irq_await_cond_fn_t cond, void *ctx,
+                    uint32_t timeout_usec, uint32_t *cycles);
+
+/**
+ * `irq_await()` for a flag that is set by an interrupt handler.
+ */
+bool irq_await_flag(volatile bool *flag, uint32_t timeout_usec,
+                    uint32_t *cycles);
+
+/**
+ * Services the timeout deadline; to be called from `handler_irq_timer()`.
+ */
+void irq_await_handle_timer_irq(void);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_IRQ_AWAIT_H_
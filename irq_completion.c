@@ -0,0 +1,44 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "irq_completion.h"
+
+#include "irq_await.h"
+#include "irq_lock.h"
+
+bool irq_completion_set(irq_completion_t *set, uint32_t irq) {
+  uint32_t bit = 1u << irq;
+  uint32_t irq_state = irq_lock_acquire();
+  uint32_t bits = set->bits;
+  set->bits = bits | bit;
+  irq_lock_release(irq_state);
+  return (bits & bit) != 0;
+}
+
+void irq_completion_clear(irq_completion_t *set, uint32_t mask) {
+  irq_completion_take(set, mask);
+}
+
+uint32_t irq_completion_take(irq_completion_t *set, uint32_t mask) {
+  uint32_t irq_state = irq_lock_acquire();
+  uint32_t bits = set->bits;
+  set->bits = bits & ~mask;
+  irq_lock_release(irq_state);
+  return bits & mask;
+}
+
+typedef struct completion_wait {
+  irq_completion_t *set;
+  uint32_t mask;
+} completion_wait_t;
+
+static bool completion_done(void *ctx) {
+  const completion_wait_t *wait = ctx;
+  return (wait->set->bits & wait->mask) == wait->mask;
+}
+
+bool irq_completion_await(irq_completion_t *set, uint32_t mask,
+                          uint32_t timeout_usec, uint32_t *cycles) {
+  completion_wait_t wait = {.set = set, .mask = mask};
+  return irq_await(completion_done, &wait, timeout_usec, cycles);
+}
@@ -0,0 +1,56 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_IRQ_COMPLETION_H_
+#define ATHOS_SW_DIF_SMOKETEST_IRQ_COMPLETION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Completion set of the interrupts of one peripheral.
+ *
+ * One bit per IRQ of the peripheral, e.g. indexed by `dif_uart_irq_t`, in a
+ * single word: handlers set their bit, and the test waits for a whole mask of
+ * them at once, so that any number of forced IRQs can be in flight together.
+ *
+ * Ibex has no atomic instructions; every read-modify-write of the word is
+ * done with interrupts masked instead, on both sides, which also keeps it
+ * safe from nested handlers.
+ */
+typedef struct irq_completion {
+  volatile uint32_t bits;
+} irq_completion_t;
+
+/**
+ * Marks `irq` of `set` as handled; called from the handler of `irq`.
+ *
+ * @param set Completion set of the peripheral.
+ * @param irq Bit index of the interrupt, less than 32.
+ * @return True if `irq` was already marked, i.e. it was handled twice.
+ */
+bool irq_completion_set(irq_completion_t *set, uint32_t irq);
+
+/**
+ * Unmarks the interrupts in `mask`, e.g. before forcing them.
+ */
+void irq_completion_clear(irq_completion_t *set, uint32_t mask);
+
+/**
+ * Returns the marked interrupts of `mask`, and unmarks them.
+ */
+uint32_t irq_completion_take(irq_completion_t *set, uint32_t mask);
+
+/**
+ * Waits until every interrupt in `mask` is marked, with `irq_await()`.
+ *
+ * @param set Completion set of the peripheral.
+ * @param mask Interrupts to wait for.
+ * @param timeout_usec Timeout in microseconds.
+ * @param[out] cycles Optional; CPU cycles until all were marked, or timed out.
+ * @return True if all of `mask` was marked before the timeout.
+ */
+bool irq_completion_await(irq_completion_t *set, uint32_t mask,
+                          uint32_t timeout_usec, uint32_t *cycles);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_IRQ_COMPLETION_H_
@@ -0,0 +1,47 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_IRQ_LOCK_H_
+#define ATHOS_SW_DIF_SMOKETEST_IRQ_LOCK_H_
+
+#include <stdint.h>
+
+#include "base/csr.h"
+
+/**
+ * Critical sections for the single Ibex hart.
+ *
+ * Unlike `irq_global_ctrl()`, which unconditionally sets the global interrupt
+ * enable, these save and restore it, so they nest and may be used from ISRs as
+ * well as from the main program.
+ */
+
+/**
+ * Machine Interrupt Enable bit of `mstatus`.
+ */
+#define IRQ_LOCK_MSTATUS_MIE (1u << 3)
+
+/**
+ * Masks all interrupts.
+ *
+ * @return The previous interrupt state, to be passed to `irq_lock_release()`.
+ */
+static inline uint32_t irq_lock_acquire(void) {
+  uint32_t mstatus;
+  CSR_READ(CSR_REG_MSTATUS, &mstatus);
+  CSR_CLEAR_BITS(CSR_REG_MSTATUS, IRQ_LOCK_MSTATUS_MIE);
+  return mstatus & IRQ_LOCK_MSTATUS_MIE;
+}
+
+/**
+ * Restores the interrupt state saved by `irq_lock_acquire()`.
+ *
+ * @param state Value returned by the matching `irq_lock_acquire()`.
+ */
+static inline void irq_lock_release(uint32_t state) {
+  if (state != 0) {
+    CSR_SET_BITS(CSR_REG_MSTATUS, IRQ_LOCK_MSTATUS_MIE);
+  }
+}
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_IRQ_LOCK_H_
@@ -0,0 +1,157 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "log_token.h"
+
+#include "dif/check.h"
+#include "irq_lock.h"
+#include "ring_buffer.h"
+#include "uart_burst.h"
+
+enum {
+  /**
+   * Sync byte, argument count and token.
+   */
+  kLogTokenHeaderBytes = 6,
+  kLogTokenMaxRecordBytes = kLogTokenHeaderBytes + 4 * kLogTokenMaxArgs,
+  /**
+   * Bytes moved from the ring into the TX FIFO in one go; matches the depth of
+   * the UART FIFOs.
+   */
+  kLogTokenChunkBytes = 32,
+};
+
+static const dif_uart_t *log_uart;
+
+// Deferred mode state. Records may be logged from the main program and from
+// ISRs alike, so producers serialise on `irq_lock_acquire()`; the ring itself
+// is single-producer, single-consumer.
+static bool log_deferred;
+static ring_buffer_t log_ring;
+static volatile bool log_tx_active;
+static volatile uint32_t log_dropped;
+
+void log_token_init(const dif_uart_t *uart) {
+  log_deferred = false;
+  log_uart = uart;
+}
+
+void log_token_init_deferred(const dif_uart_t *uart, uint8_t *storage,
+                             size_t size) {
+  ring_buffer_init(&log_ring, storage, size);
+  log_tx_active = false;
+  log_dropped = 0;
+
+  // Refill only once the TX FIFO is nearly empty, to move as many bytes as
+  // possible per interrupt.
+  CHECK(dif_uart_watermark_tx_set(uart, kDifUartWatermarkTxByte4) ==
+        kDifUartOk);
+  CHECK(dif_uart_irq_set_enabled(uart, kDifUartIrqTxWatermark,
+                                 kDifUartToggleEnabled) == kDifUartOk,
+        "TX FIFO dips below its watermark IRQ enable failed!");
+  CHECK(dif_uart_irq_set_enabled(uart, kDifUartIrqTxEmpty,
+                                 kDifUartToggleEnabled) == kDifUartOk,
+        "TX empty IRQ enable failed!");
+
+  log_uart = uart;
+  log_deferred = true;
+}
+
+/**
+ * Moves queued records into the TX FIFO, as far as it can take them.
+ *
+ * Must be called with interrupts masked, or from the ISR.
+ */
+static void log_fill_fifo(void) {
+  for (;;) {
+    uint8_t chunk[kLogTokenChunkBytes];
+    size_t len = ring_buffer_peek(&log_ring, chunk, sizeof(chunk));
+    if (len == 0) {
+      return;
+    }
+
+    size_t written;
+    if (uart_burst_fill(log_uart, chunk, len, &written) != kDifUartOk) {
+      return;
+    }
+    ring_buffer_discard(&log_ring, written);
+    if (written < len) {
+      // TX FIFO is full.
+      return;
+    }
+  }
+}
+
+void log_token_handle_irq(dif_uart_irq_t irq) {
+  CHECK(dif_uart_irq_acknowledge(log_uart, irq) == kDifUartOk,
+        "ISR failed to clear IRQ!");
+
+  log_fill_fifo();
+
+  // The TX empty event is the last one a transmission raises; if there is
+  // nothing left to send, the next record has to prime the FIFO itself.
+  if (irq == kDifUartIrqTxEmpty && ring_buffer_used(&log_ring) == 0) {
+    log_tx_active = false;
+  }
+}
+
+void log_token_flush(void) {
+  if (!log_deferred) {
+    return;
+  }
+
+  uint32_t irq_state = irq_lock_acquire();
+  uint8_t chunk[kLogTokenChunkBytes];
+  size_t len;
+  while ((len = ring_buffer_pop(&log_ring, chunk, sizeof(chunk))) > 0) {
+    (void)uart_burst_send(log_uart, chunk, len);
+  }
+  irq_lock_release(irq_state);
+}
+
+uint32_t log_token_dropped(void) { return log_dropped; }
+
+static inline uint8_t *put_u32(uint8_t *out, uint32_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+  out[2] = (uint8_t)(value >> 16);
+  out[3] = (uint8_t)(value >> 24);
+  return out + 4;
+}
+
+void log_token_emit(uint32_t token, const uint32_t *args, size_t nargs) {
+  if (log_uart == NULL) {
+    return;
+  }
+
+  uint8_t record[kLogTokenMaxRecordBytes];
+  uint8_t *out = record;
+  *out++ = kLogTokenSync;
+  *out++ = (uint8_t)nargs;
+  out = put_u32(out, token);
+  for (size_t i = 0; i < nargs; ++i) {
+    out = put_u32(out, args[i]);
+  }
+
+  size_t len = (size_t)(out - record);
+
+  if (!log_deferred) {
+    // A failing log has nowhere to be reported to.
+    (void)uart_burst_send(log_uart, record, len);
+    return;
+  }
+
+  uint32_t irq_state = irq_lock_acquire();
+  if (ring_buffer_free(&log_ring) >= len) {
+    ring_buffer_push(&log_ring, record, len);
+    // TX watermark / TX empty are edge events: an idle FIFO raises neither,
+    // so the first record after a pause has to be pushed out from here.
+    if (!log_tx_active) {
+      log_tx_active = true;
+      log_fill_fifo();
+    }
+  } else {
+    ++log_dropped;
+  }
+  irq_lock_release(irq_state);
+}
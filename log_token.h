@@ -0,0 +1,143 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_LOG_TOKEN_H_
+#define ATHOS_SW_DIF_SMOKETEST_LOG_TOKEN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dif/check.h"
+#include "dif/dif_uart.h"
+
+/**
+ * Tokenized logging.
+ *
+ * `LOG_TOKEN_*()` does not format anything on the device. The severity, the
+ * source location and the format string are placed in the `.logs.fields`
+ * section, which the linker script marks as INFO (not loaded), and the device
+ * only transmits a compact binary record:
+ *
+ *   | kLogTokenSync | nargs | token (u32 LE) | args (nargs x u32 LE) |
+ *
+ * where `token` is the link address of the strings in `.logs.fields`.
+ * `util/log_token_decode.py` reads the strings back from the ELF and turns the
+ * records into text again; any other output on the same UART is passed
+ * through unchanged.
+ *
+ * Every argument is converted to `uint32_t`, so only integer conversions
+ * (`%d`, `%u`, `%x`, `%c`, ...) are meaningful in the format string.
+ *
+ * In deferred mode (`log_token_init_deferred()`) records are only copied into
+ * a RAM ring, and the UART TX watermark / TX empty interrupts move them to the
+ * TX FIFO in the background, so that logging never waits for the UART. Use
+ * `LOG_TOKEN_CHECK()` instead of `CHECK()` wherever records may still be
+ * queued, so that they are flushed out before the failure is reported.
+ */
+
+enum {
+  /**
+   * First byte of every record. Never occurs in plain ASCII output.
+   */
+  kLogTokenSync = 0xA5,
+  /**
+   * Maximum number of arguments per record.
+   */
+  kLogTokenMaxArgs = 8,
+};
+
+/**
+ * Selects the UART the records are written to.
+ *
+ * The UART must have been configured already, e.g. by the test framework for
+ * stdout. Records logged before this call are dropped.
+ *
+ * @param uart UART to write records to.
+ */
+void log_token_init(const dif_uart_t *uart);
+
+/**
+ * Selects the UART the records are written to, and queues records in
+ * `storage` until the UART interrupts drain them.
+ *
+ * Enables the TX watermark and TX empty interrupts of `uart`; the caller is
+ * responsible for routing them through the PLIC to `log_token_handle_irq()`.
+ *
+ * @param uart UART to write records to, already configured.
+ * @param storage Ring storage, size must be a power of two.
+ * @param size Size of `storage` in bytes.
+ */
+void log_token_init_deferred(const dif_uart_t *uart, uint8_t *storage,
+                             size_t size);
+
+/**
+ * Services a UART TX watermark / TX empty interrupt in deferred mode.
+ *
+ * Acknowledges the interrupt.
+ *
+ * @param irq The UART interrupt that has fired.
+ */
+void log_token_handle_irq(dif_uart_irq_t irq);
+
+/**
+ * Synchronously writes out every queued record.
+ *
+ * May be called with interrupts masked, e.g. on a failure path or before the
+ * test returns. Does nothing outside of deferred mode.
+ */
+void log_token_flush(void);
+
+/**
+ * Returns the number of records dropped because the ring was full.
+ */
+uint32_t log_token_dropped(void);
+
+/**
+ * Writes one record. Use the `LOG_TOKEN_*()` macros instead.
+ *
+ * @param token Link address of the record's strings.
+ * @param args Arguments of the record.
+ * @param nargs Number of entries in `args`, at most `kLogTokenMaxArgs`.
+ */
+void log_token_emit(uint32_t token, const uint32_t *args, size_t nargs);
+
+#define LOG_TOKEN_STRINGIFY_(x) #x
+#define LOG_TOKEN_STRINGIFY(x) LOG_TOKEN_STRINGIFY_(x)
+
+/**
+ * Emits a tokenized record with the given severity character.
+ *
+ * The strings are laid out as "<severity><file>:<line>\0<format>\0".
+ */
+#define LOG_TOKEN_(severity, format, ...)                                   \
+  do {                                                                      \
+    static const char kLogToken_[]                                          \
+        __attribute__((section(".logs.fields"), used)) =                    \
+            severity __FILE__ ":" LOG_TOKEN_STRINGIFY(__LINE__) "\0" format; \
+    const uint32_t kLogTokenArgs_[] = {0, ##__VA_ARGS__};                   \
+    _Static_assert(sizeof(kLogTokenArgs_) / sizeof(uint32_t) - 1 <=         \
+                       kLogTokenMaxArgs,                                    \
+                   "Too many arguments for a tokenized log!");              \
+    log_token_emit((uint32_t)(uintptr_t)kLogToken_, &kLogTokenArgs_[1],     \
+                   sizeof(kLogTokenArgs_) / sizeof(uint32_t) - 1);          \
+  } while (false)
+
+/**
+ * Like `CHECK()`, but flushes any queued records before reporting the failure.
+ *
+ * The condition is evaluated exactly once.
+ */
+#define LOG_TOKEN_CHECK(condition, ...)            \
+  do {                                             \
+    if (!(condition)) {                            \
+      log_token_flush();                           \
+      CHECK(false, #condition " " __VA_ARGS__);    \
+    }                                              \
+  } while (false)
+
+#define LOG_TOKEN_INFO(format, ...) LOG_TOKEN_("I", format, ##__VA_ARGS__)
+#define LOG_TOKEN_WARNING(format, ...) LOG_TOKEN_("W", format, ##__VA_ARGS__)
+#define LOG_TOKEN_ERROR(format, ...) LOG_TOKEN_("E", format, ##__VA_ARGS__)
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_LOG_TOKEN_H_
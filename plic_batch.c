@@ -0,0 +1,105 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "plic_batch.h"
+
+#include <stdbool.h>
+
+#include "base/mmio.h"
+
+#include "rv_plic_regs.h"  // Generated.
+
+enum {
+  /**
+   * Number of 32-bit words of the trigger and of each target's enable
+   * bitfield.
+   */
+  kPlicBatchRegWords = (RV_PLIC_PARAM_NUMSRC + 31) / 32,
+};
+
+/**
+ * Bits of one bitfield register word that the table sets, and the bits it
+ * touches at all.
+ */
+typedef struct plic_batch_word {
+  uint32_t set;
+  uint32_t mask;
+} plic_batch_word_t;
+
+static bool entry_is_valid(const plic_batch_entry_t *entry) {
+  // IRQ ID 0 is reserved for "no interrupt".
+  return entry->irq != 0 && entry->irq < RV_PLIC_PARAM_NUMSRC &&
+         entry->priority <= kDifPlicMaxPriority &&
+         entry->target < RV_PLIC_PARAM_NUMTARGET &&
+         (entry->trigger == kDifPlicIrqTriggerEdge ||
+          entry->trigger == kDifPlicIrqTriggerLevel);
+}
+
+/**
+ * Applies `word` to the register at `offset`, with a single read and a single
+ * write, or just a write if every bit of the register is set by the table.
+ */
+static void word_apply(mmio_region_t base, ptrdiff_t offset,
+                       plic_batch_word_t word) {
+  if (word.mask == 0) {
+    return;
+  }
+
+  uint32_t reg = word.set;
+  if (word.mask != UINT32_MAX) {
+    reg |= mmio_region_read32(base, offset) & ~word.mask;
+  }
+  mmio_region_write32(base, offset, reg);
+}
+
+dif_plic_result_t plic_batch_configure(const dif_plic_t *plic,
+                                       const plic_batch_entry_t *entries,
+                                       size_t count) {
+  if (plic == NULL || (entries == NULL && count != 0)) {
+    return kDifPlicBadArg;
+  }
+
+  plic_batch_word_t trigger[kPlicBatchRegWords] = {{0}};
+  plic_batch_word_t enable[RV_PLIC_PARAM_NUMTARGET][kPlicBatchRegWords] = {
+      {{0}}};
+
+  for (size_t i = 0; i < count; ++i) {
+    const plic_batch_entry_t *entry = &entries[i];
+    if (!entry_is_valid(entry)) {
+      return kDifPlicBadArg;
+    }
+
+    size_t word = entry->irq / 32;
+    uint32_t bit = 1u << (entry->irq % 32);
+    trigger[word].mask |= bit;
+    if (entry->trigger == kDifPlicIrqTriggerEdge) {
+      trigger[word].set |= bit;
+    }
+    enable[entry->target][word].mask |= bit;
+    enable[entry->target][word].set |= bit;
+  }
+
+  mmio_region_t base = plic->params.base_addr;
+  for (size_t i = 0; i < count; ++i) {
+    // Priorities have a register per IRQ, there is nothing to gather.
+    mmio_region_write32(
+        base,
+        RV_PLIC_PRIO0_REG_OFFSET + entries[i].irq * (ptrdiff_t)sizeof(uint32_t),
+        entries[i].priority);
+  }
+  for (size_t word = 0; word < kPlicBatchRegWords; ++word) {
+    word_apply(base, RV_PLIC_LE_0_REG_OFFSET + word * sizeof(uint32_t),
+               trigger[word]);
+  }
+  for (size_t target = 0; target < RV_PLIC_PARAM_NUMTARGET; ++target) {
+    // The enable bitfields of the targets follow each other.
+    ptrdiff_t target_offset = RV_PLIC_IE0_0_REG_OFFSET +
+                              target * kPlicBatchRegWords * sizeof(uint32_t);
+    for (size_t word = 0; word < kPlicBatchRegWords; ++word) {
+      word_apply(base, target_offset + word * sizeof(uint32_t),
+                 enable[target][word]);
+    }
+  }
+
+  return kDifPlicOk;
+}
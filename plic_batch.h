@@ -0,0 +1,52 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_PLIC_BATCH_H_
+#define ATHOS_SW_DIF_SMOKETEST_PLIC_BATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dif/dif_plic.h"
+
+/**
+ * Table driven PLIC configuration.
+ *
+ * `dif_plic_irq_set_trigger()` and `dif_plic_irq_set_enabled()` each do a
+ * read-modify-write of a whole bitfield register for a single IRQ. Applying a
+ * table of IRQs instead gathers the bits of every entry per register word
+ * first, so each touched trigger and enable word is read and written once,
+ * however many of its IRQs the table configures.
+ */
+
+/**
+ * Configuration of one PLIC interrupt source.
+ */
+typedef struct plic_batch_entry {
+  dif_plic_irq_id_t irq;
+  uint32_t priority;
+  dif_plic_irq_trigger_t trigger;
+  /**
+   * Target the IRQ is enabled for; it is left as is for any other target.
+   */
+  dif_plic_target_t target;
+} plic_batch_entry_t;
+
+/**
+ * Applies `entries` to `plic`: sets the trigger type and priority of each
+ * IRQ, and enables it for its target.
+ *
+ * IRQs that are not in the table keep their configuration. Nothing is
+ * written if any entry is invalid.
+ *
+ * @param plic PLIC to configure.
+ * @param entries Configuration table.
+ * @param count Number of entries in `entries`.
+ * @return kDifPlicBadArg if an entry has an invalid IRQ ID, priority or
+ *         target, kDifPlicOk otherwise.
+ */
+dif_plic_result_t plic_batch_configure(const dif_plic_t *plic,
+                                       const plic_batch_entry_t *entries,
+                                       size_t count);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_PLIC_BATCH_H_
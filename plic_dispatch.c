@@ -0,0 +1,163 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "plic_dispatch.h"
+
+#include "base/csr.h"
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/check.h"
+#include "dif/log.h"
+#include "dif/test_status.h"
+#include "irq_lock.h"
+
+#include "rv_plic_regs.h"  // Generated.
+
+static const dif_plic_t *dispatch_plic;
+static dif_plic_target_t dispatch_target;
+
+static plic_dispatch_mode_t dispatch_mode;
+static plic_dispatch_stats_t dispatch_stats;
+
+/**
+ * Current threshold of the target, and handlers currently active.
+ */
+static uint32_t dispatch_threshold;
+static uint32_t dispatch_depth;
+
+static plic_dispatch_entry_t vectors[kTopAthosPlicIrqIdLast + 1];
+
+static void dispatch_unhandled(void *ctx, dif_plic_irq_id_t irq_id) {
+  LOG_FATAL("IRQ %d has no handler!", irq_id);
+  test_status_set(kTestStatusFailed);
+}
+
+void plic_dispatch_init(const dif_plic_t *plic, dif_plic_target_t target) {
+  dispatch_plic = plic;
+  dispatch_target = target;
+  dispatch_mode = kPlicDispatchModeSingle;
+  dispatch_stats = (plic_dispatch_stats_t){0};
+  dispatch_threshold = kDifPlicMinPriority;
+  dispatch_depth = 0;
+  for (size_t i = 0; i < ARRAYSIZE(vectors); ++i) {
+    vectors[i] = (plic_dispatch_entry_t){.fn = dispatch_unhandled};
+  }
+}
+
+void plic_dispatch_register(dif_plic_irq_id_t irq_id, plic_dispatch_fn_t fn,
+                            void *ctx) {
+  // IRQ ID 0 is reserved for "no interrupt".
+  CHECK(irq_id != 0 && irq_id < ARRAYSIZE(vectors), "Invalid IRQ ID %d!",
+        irq_id);
+  CHECK(fn != NULL, "IRQ %d handler is NULL!", irq_id);
+  vectors[irq_id] = (plic_dispatch_entry_t){.fn = fn, .ctx = ctx};
+}
+
+void plic_dispatch_register_range(dif_plic_irq_id_t first_irq_id,
+                                  size_t count, plic_dispatch_fn_t fn,
+                                  void *ctx) {
+  for (size_t i = 0; i < count; ++i) {
+    plic_dispatch_register(first_irq_id + i, fn, ctx);
+  }
+}
+
+void plic_dispatch_set_mode(plic_dispatch_mode_t mode) {
+  dispatch_mode = mode;
+}
+
+static void threshold_set(uint32_t threshold) {
+  CHECK(dif_plic_target_set_threshold(dispatch_plic, dispatch_target,
+                                      threshold) == kDifPlicOk,
+        "threshold set failed!");
+  dispatch_threshold = threshold;
+}
+
+void plic_dispatch_set_threshold(uint32_t threshold) {
+  uint32_t irq_state = irq_lock_acquire();
+  threshold_set(threshold);
+  irq_lock_release(irq_state);
+}
+
+plic_dispatch_stats_t plic_dispatch_stats(bool reset) {
+  uint32_t irq_state = irq_lock_acquire();
+  plic_dispatch_stats_t stats = dispatch_stats;
+  if (reset) {
+    dispatch_stats = (plic_dispatch_stats_t){0};
+  }
+  irq_lock_release(irq_state);
+  return stats;
+}
+
+/**
+ * Calls the handler of `irq_id` with interrupts enabled, and only those of a
+ * higher priority let through by the target.
+ */
+static void dispatch_preemptible(const plic_dispatch_entry_t *entry,
+                                 dif_plic_irq_id_t irq_id) {
+  uint32_t priority =
+      mmio_region_read32(dispatch_plic->params.base_addr,
+                         RV_PLIC_PRIO0_REG_OFFSET + irq_id * sizeof(uint32_t));
+  uint32_t threshold = dispatch_threshold;
+  threshold_set(priority);
+
+  // A nested trap overwrites the trap state of this one; `mstatus` holds the
+  // interrupt enable and privilege to return with.
+  uint32_t mepc;
+  uint32_t mstatus;
+  CSR_READ(CSR_REG_MEPC, &mepc);
+  CSR_READ(CSR_REG_MSTATUS, &mstatus);
+
+  CSR_SET_BITS(CSR_REG_MSTATUS, IRQ_LOCK_MSTATUS_MIE);
+  entry->fn(entry->ctx, irq_id);
+  CSR_CLEAR_BITS(CSR_REG_MSTATUS, IRQ_LOCK_MSTATUS_MIE);
+
+  CSR_WRITE(CSR_REG_MEPC, mepc);
+  CSR_WRITE(CSR_REG_MSTATUS, mstatus);
+  threshold_set(threshold);
+}
+
+void plic_dispatch_handle(void) {
+  uint32_t serviced = 0;
+  for (;;) {
+    // Claim the IRQ by reading the Ibex specific CC register.
+    dif_plic_irq_id_t interrupt_id;
+    CHECK(dif_plic_irq_claim(dispatch_plic, dispatch_target, &interrupt_id) ==
+              kDifPlicOk,
+          "ISR is not implemented!");
+    // IRQ ID 0 means that nothing is pending any more; the trap itself must
+    // have had a source though, so the first claim is dispatched regardless.
+    if (interrupt_id == 0 && serviced != 0) {
+      break;
+    }
+
+    // The claimed ID is always within the table; only registered IDs are
+    // enabled, the rest point at `dispatch_unhandled()`.
+    const plic_dispatch_entry_t *entry = &vectors[interrupt_id];
+    if (++dispatch_depth > dispatch_stats.max_depth) {
+      dispatch_stats.max_depth = dispatch_depth;
+    }
+    if (dispatch_mode == kPlicDispatchModeNested) {
+      dispatch_preemptible(entry, interrupt_id);
+    } else {
+      entry->fn(entry->ctx, interrupt_id);
+    }
+    --dispatch_depth;
+
+    // Complete the IRQ by writing the IRQ source to the Ibex specific CC
+    // register.
+    CHECK(dif_plic_irq_complete(dispatch_plic, dispatch_target,
+                                &interrupt_id) == kDifPlicOk,
+          "Unable to complete the IRQ request!");
+
+    ++serviced;
+    if (dispatch_mode != kPlicDispatchModeDrain) {
+      break;
+    }
+  }
+
+  ++dispatch_stats.traps;
+  dispatch_stats.irqs += serviced;
+  if (serviced > dispatch_stats.max_irqs_per_trap) {
+    dispatch_stats.max_irqs_per_trap = serviced;
+  }
+}
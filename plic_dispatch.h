@@ -0,0 +1,140 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_PLIC_DISPATCH_H_
+#define ATHOS_SW_DIF_SMOKETEST_PLIC_DISPATCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dif/dif_plic.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * Vector table for external interrupts.
+ *
+ * Every PLIC IRQ ID has an entry with a handler and a context pointer, filled
+ * in at registration time, where the IRQ ID is also validated. The trap path
+ * is then claim, an indirect call through the entry of the claimed IRQ, and
+ * complete; no peripheral lookup or dispatch `switch` per interrupt. IRQs
+ * without a registered handler fail the test.
+ */
+
+/**
+ * Services one external interrupt.
+ *
+ * @param ctx Context registered with the handler.
+ * @param irq_id The claimed PLIC IRQ ID.
+ */
+typedef void (*plic_dispatch_fn_t)(void *ctx, dif_plic_irq_id_t irq_id);
+
+typedef struct plic_dispatch_entry {
+  plic_dispatch_fn_t fn;
+  void *ctx;
+} plic_dispatch_entry_t;
+
+/**
+ * How many interrupts `plic_dispatch_handle()` services per trap.
+ */
+typedef enum plic_dispatch_mode {
+  /**
+   * One claim and complete per trap.
+   */
+  kPlicDispatchModeSingle,
+  /**
+   * Keeps claiming until the PLIC has no pending source left, so that a burst
+   * of interrupts costs a single trap entry and exit.
+   */
+  kPlicDispatchModeDrain,
+  /**
+   * One claim per trap, with the handler preemptible by higher priority
+   * interrupts: the target threshold is raised to the priority of the claimed
+   * IRQ and interrupts are re-enabled around its handler, then both are
+   * restored before the IRQ is completed.
+   */
+  kPlicDispatchModeNested,
+} plic_dispatch_mode_t;
+
+/**
+ * Interrupt counters of `plic_dispatch_handle()`.
+ */
+typedef struct plic_dispatch_stats {
+  /**
+   * Calls of `plic_dispatch_handle()`, i.e. external interrupt traps.
+   */
+  uint32_t traps;
+  /**
+   * Interrupts serviced.
+   */
+  uint32_t irqs;
+  /**
+   * Most interrupts serviced in a single trap.
+   */
+  uint32_t max_irqs_per_trap;
+  /**
+   * Most handlers active at the same time; above one only if a handler has
+   * been preempted, in `kPlicDispatchModeNested`.
+   */
+  uint32_t max_depth;
+} plic_dispatch_stats_t;
+
+/**
+ * Resets every entry to the unhandled IRQ handler, the mode to
+ * `kPlicDispatchModeSingle` and the counters to zero, and sets the PLIC
+ * target that `plic_dispatch_handle()` claims from.
+ *
+ * The target threshold is taken to be `kDifPlicMinPriority` until set with
+ * `plic_dispatch_set_threshold()`.
+ *
+ * @param plic PLIC to claim interrupts from.
+ * @param target PLIC target of the hart.
+ */
+void plic_dispatch_init(const dif_plic_t *plic, dif_plic_target_t target);
+
+/**
+ * Registers `fn` to service `irq_id`, replacing any previous handler.
+ *
+ * @param irq_id PLIC IRQ ID to service.
+ * @param fn Handler; called with `ctx` and `irq_id`.
+ * @param ctx Passed to `fn`.
+ */
+void plic_dispatch_register(dif_plic_irq_id_t irq_id, plic_dispatch_fn_t fn,
+                            void *ctx);
+
+/**
+ * Registers `fn` to service `count` consecutive IRQ IDs, starting from
+ * `first_irq_id`; e.g. all interrupts of a peripheral instance.
+ */
+void plic_dispatch_register_range(dif_plic_irq_id_t first_irq_id,
+                                  size_t count, plic_dispatch_fn_t fn,
+                                  void *ctx);
+
+/**
+ * Sets how many interrupts `plic_dispatch_handle()` services per trap.
+ */
+void plic_dispatch_set_mode(plic_dispatch_mode_t mode);
+
+/**
+ * Sets the priority threshold of the target, outside of any handler.
+ *
+ * In `kPlicDispatchModeNested` the threshold must only be set through here,
+ * as it is restored to this value after each preemptible handler.
+ */
+void plic_dispatch_set_threshold(uint32_t threshold);
+
+/**
+ * Returns the interrupt counters, and resets them if `reset` is set.
+ */
+plic_dispatch_stats_t plic_dispatch_stats(bool reset);
+
+/**
+ * Claims an external interrupt, calls its handler and completes it; in
+ * `kPlicDispatchModeDrain`, repeats until no interrupt is pending.
+ *
+ * Meant to be called from, or be the body of, `handler_irq_external()`.
+ */
+void plic_dispatch_handle(void);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_PLIC_DISPATCH_H_
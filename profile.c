@@ -0,0 +1,104 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "profile.h"
+
+#include "dif/log.h"
+#include "irq_lock.h"
+
+// `inline` definitions in the header need exactly one external definition.
+extern profile_stamp_t profile_stamp_read(void);
+extern profile_scope_t profile_scope_begin(profile_region_t *region);
+
+enum {
+  kCalibrationRounds = 8,
+};
+
+/**
+ * Regions in the order they first ended.
+ */
+static profile_region_t *regions;
+static profile_region_t **regions_tail = &regions;
+
+/**
+ * Cost of timing an empty region.
+ */
+static uint32_t overhead_cycles;
+static uint32_t overhead_instrs;
+
+static profile_region_t calibration = {.name = "calibration"};
+
+static uint32_t saturating_sub(uint32_t a, uint32_t b) {
+  return a > b ? a - b : 0;
+}
+
+void profile_scope_end(profile_scope_t *scope) {
+  profile_stamp_t end = profile_stamp_read();
+  uint32_t cycles =
+      saturating_sub(end.cycles - scope->start.cycles, overhead_cycles);
+  uint32_t instrs =
+      saturating_sub(end.instrs - scope->start.instrs, overhead_instrs);
+  uint32_t ticks = end.ticks - scope->start.ticks;
+
+  uint32_t irq_state = irq_lock_acquire();
+  profile_region_t *region = scope->region;
+  if (region->count == 0) {
+    region->next = NULL;
+    *regions_tail = region;
+    regions_tail = &region->next;
+    region->min_cycles = UINT32_MAX;
+    region->max_cycles = 0;
+  }
+  ++region->count;
+  region->cycles += cycles;
+  region->instrs += instrs;
+  region->ticks += ticks;
+  if (cycles < region->min_cycles) {
+    region->min_cycles = cycles;
+  }
+  if (cycles > region->max_cycles) {
+    region->max_cycles = cycles;
+  }
+  irq_lock_release(irq_state);
+}
+
+/**
+ * Unregisters every region, with its statistics.
+ */
+static void regions_reset(void) {
+  for (profile_region_t *region = regions; region != NULL;) {
+    profile_region_t *next = region->next;
+    *region = (profile_region_t){.name = region->name};
+    region = next;
+  }
+  regions = NULL;
+  regions_tail = &regions;
+}
+
+void profile_init(void) {
+  uint32_t irq_state = irq_lock_acquire();
+  regions_reset();
+  overhead_cycles = 0;
+  overhead_instrs = 0;
+  for (int i = 0; i < kCalibrationRounds; ++i) {
+    profile_scope_t scope = profile_scope_begin(&calibration);
+    profile_scope_end(&scope);
+  }
+  overhead_cycles = calibration.min_cycles;
+  overhead_instrs = (uint32_t)(calibration.instrs / calibration.count);
+  regions_reset();
+  irq_lock_release(irq_state);
+}
+
+void profile_dump(void) {
+  LOG_INFO("profile: %d cycles, %d instructions of timing overhead removed",
+           overhead_cycles, overhead_instrs);
+  for (profile_region_t *region = regions; region != NULL;
+       region = region->next) {
+    LOG_INFO("profile %s: count=%u mean=%u min=%u max=%u instrs=%u ticks=%u",
+             region->name, region->count,
+             (uint32_t)(region->cycles / region->count), region->min_cycles,
+             region->max_cycles, (uint32_t)(region->instrs / region->count),
+             (uint32_t)region->ticks);
+  }
+}
@@ -0,0 +1,122 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_PROFILE_H_
+#define ATHOS_SW_DIF_SMOKETEST_PROFILE_H_
+
+#include <stdint.h>
+
+#include "base/csr.h"
+#include "base/mmio.h"
+
+#include "rv_timer_regs.h"             // Generated.
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * Lightweight profiling of code regions.
+ *
+ * A timestamp is the low words of mcycle and minstret, and of the rv_timer
+ * counter of hart 0 as a wall-clock reference: three reads, without the
+ * hi/lo/hi sequence or error checking of the DIF, and without a branch. The
+ * differences between two timestamps are exact for regions shorter than 2^32
+ * cycles. The rv_timer ticks are at whatever rate the test set, and stay at
+ * zero if it did not start the counter.
+ *
+ * Regions are named, and timed from their start to the end of the enclosing
+ * scope:
+ *
+ *   {
+ *     PROFILE_SCOPE("uart_fifo_reset");
+ *     ...
+ *   }
+ *
+ * or around a single expression, whose value is kept:
+ *
+ *   CHECK(PROFILE_CALL("dif_uart_init", dif_uart_init(...)) == kDifUartOk);
+ *
+ * Every region has a static statistics entry, registered the first time it
+ * ends; `profile_dump()` logs them all.
+ */
+
+typedef struct profile_stamp {
+  uint32_t cycles;
+  uint32_t instrs;
+  uint32_t ticks;
+} profile_stamp_t;
+
+/**
+ * Statistics of a region; zero initialised but for `name`.
+ */
+typedef struct profile_region {
+  const char *name;
+  struct profile_region *next;
+  uint32_t count;
+  uint32_t min_cycles;
+  uint32_t max_cycles;
+  uint64_t cycles;
+  uint64_t instrs;
+  uint64_t ticks;
+} profile_region_t;
+
+typedef struct profile_scope {
+  profile_region_t *region;
+  profile_stamp_t start;
+} profile_scope_t;
+
+/**
+ * Reads a timestamp.
+ */
+inline profile_stamp_t profile_stamp_read(void) {
+  profile_stamp_t stamp;
+  CSR_READ(CSR_REG_MCYCLE, &stamp.cycles);
+  CSR_READ(CSR_REG_MINSTRET, &stamp.instrs);
+  stamp.ticks =
+      mmio_region_read32(mmio_region_from_addr(TOP_ATHOS_RV_TIMER_BASE_ADDR),
+                         RV_TIMER_TIMER_V_LOWER0_REG_OFFSET);
+  return stamp;
+}
+
+inline profile_scope_t profile_scope_begin(profile_region_t *region) {
+  return (profile_scope_t){.region = region, .start = profile_stamp_read()};
+}
+
+/**
+ * Adds the time since `scope` began to its region.
+ */
+void profile_scope_end(profile_scope_t *scope);
+
+/**
+ * Measures the cost of timing an empty region, which is then subtracted from
+ * every region, and resets the statistics of all regions.
+ */
+void profile_init(void);
+
+/**
+ * Logs the statistics of every region: count, and mean/min/max cycles, mean
+ * instructions and total rv_timer ticks.
+ */
+void profile_dump(void);
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+/**
+ * Times the rest of the enclosing scope as the region `name_`.
+ */
+#define PROFILE_SCOPE(name_)                                          \
+  static profile_region_t PROFILE_CONCAT(profile_region_, __LINE__) = \
+      {.name = (name_)};                                              \
+  profile_scope_t PROFILE_CONCAT(profile_scope_, __LINE__)            \
+      __attribute__((cleanup(profile_scope_end))) =                   \
+          profile_scope_begin(&PROFILE_CONCAT(profile_region_, __LINE__))
+
+/**
+ * Times `expr` as the region `name_`, and evaluates to its value.
+ */
+#define PROFILE_CALL(name_, expr) \
+  ({                              \
+    PROFILE_SCOPE(name_);         \
+    expr;                         \
+  })
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_PROFILE_H_
@@ -0,0 +1,64 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "ring_buffer.h"
+
+#include "dif/check.h"
+
+// `inline` definitions in the header need exactly one external definition.
+extern size_t ring_buffer_used(const ring_buffer_t *ring);
+extern size_t ring_buffer_free(const ring_buffer_t *ring);
+
+void ring_buffer_init(ring_buffer_t *ring, uint8_t *storage, size_t capacity) {
+  CHECK(capacity != 0 && (capacity & (capacity - 1)) == 0,
+        "Ring buffer capacity must be a power of two!");
+  ring->data = storage;
+  ring->mask = capacity - 1;
+  ring->head = 0;
+  ring->tail = 0;
+}
+
+size_t ring_buffer_push(ring_buffer_t *ring, const uint8_t *data, size_t len) {
+  size_t space = ring_buffer_free(ring);
+  if (len > space) {
+    len = space;
+  }
+
+  uint32_t head = ring->head;
+  for (size_t i = 0; i < len; ++i) {
+    ring->data[(head + i) & ring->mask] = data[i];
+  }
+
+  // The data must be visible before the consumer can observe the new head.
+  __atomic_signal_fence(__ATOMIC_RELEASE);
+  ring->head = head + len;
+
+  return len;
+}
+
+size_t ring_buffer_peek(const ring_buffer_t *ring, uint8_t *data, size_t len) {
+  size_t used = ring_buffer_used(ring);
+  if (len > used) {
+    len = used;
+  }
+
+  uint32_t tail = ring->tail;
+  __atomic_signal_fence(__ATOMIC_ACQUIRE);
+  for (size_t i = 0; i < len; ++i) {
+    data[i] = ring->data[(tail + i) & ring->mask];
+  }
+
+  return len;
+}
+
+void ring_buffer_discard(ring_buffer_t *ring, size_t len) {
+  // The data must be read before the producer can reuse the slots.
+  __atomic_signal_fence(__ATOMIC_RELEASE);
+  ring->tail += len;
+}
+
+size_t ring_buffer_pop(ring_buffer_t *ring, uint8_t *data, size_t len) {
+  len = ring_buffer_peek(ring, data, len);
+  ring_buffer_discard(ring, len);
+  return len;
+}
@@ -0,0 +1,85 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_RING_BUFFER_H_
+#define ATHOS_SW_DIF_SMOKETEST_RING_BUFFER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Single-producer, single-consumer byte ring buffer.
+ *
+ * One side (typically an ISR) pushes and the other side pops, without any
+ * locking: `head` is only written by the producer and `tail` is only written
+ * by the consumer. Both indices run freely and are reduced modulo the
+ * capacity on access, so the capacity must be a power of two.
+ */
+typedef struct ring_buffer {
+  uint8_t *data;
+  uint32_t mask;
+  volatile uint32_t head;
+  volatile uint32_t tail;
+} ring_buffer_t;
+
+/**
+ * Initialises `ring` over caller provided `storage`.
+ *
+ * @param ring Ring buffer to initialise.
+ * @param storage Backing storage, owned by the caller.
+ * @param capacity Size of `storage` in bytes, must be a power of two.
+ */
+void ring_buffer_init(ring_buffer_t *ring, uint8_t *storage, size_t capacity);
+
+/**
+ * Returns the number of bytes that can be popped from `ring`.
+ */
+inline size_t ring_buffer_used(const ring_buffer_t *ring) {
+  return ring->head - ring->tail;
+}
+
+/**
+ * Returns the number of bytes that can be pushed into `ring`.
+ */
+inline size_t ring_buffer_free(const ring_buffer_t *ring) {
+  return ring->mask + 1 - ring_buffer_used(ring);
+}
+
+/**
+ * Pushes up to `len` bytes from `data` into `ring`.
+ *
+ * Producer side only.
+ *
+ * @return The number of bytes actually pushed.
+ */
+size_t ring_buffer_push(ring_buffer_t *ring, const uint8_t *data, size_t len);
+
+/**
+ * Pops up to `len` bytes from `ring` into `data`.
+ *
+ * Consumer side only.
+ *
+ * @return The number of bytes actually popped.
+ */
+size_t ring_buffer_pop(ring_buffer_t *ring, uint8_t *data, size_t len);
+
+/**
+ * Copies up to `len` bytes from the front of `ring` into `data`, without
+ * removing them.
+ *
+ * Consumer side only.
+ *
+ * @return The number of bytes copied.
+ */
+size_t ring_buffer_peek(const ring_buffer_t *ring, uint8_t *data, size_t len);
+
+/**
+ * Removes `len` bytes from the front of `ring`, typically after they have been
+ * consumed through `ring_buffer_peek()`.
+ *
+ * Consumer side only. `len` must not exceed `ring_buffer_used()`.
+ */
+void ring_buffer_discard(ring_buffer_t *ring, size_t len);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_RING_BUFFER_H_
@@ -0,0 +1,144 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "rv_timer_service.h"
+
+#include "base/mmio.h"
+#include "dif/check.h"
+#include "dif/irq.h"
+#include "irq_lock.h"
+#include "rv_timer_tick_params.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+typedef struct comparator {
+  rv_timer_service_fn_t fn;
+  void *ctx;
+  /**
+   * Counter value the comparator is armed for; `UINT64_MAX` when disarmed.
+   */
+  uint64_t deadline;
+} comparator_t;
+
+static dif_rv_timer_t *service_timer;
+static comparator_t comparators[kRvTimerServiceHarts]
+                               [kRvTimerServiceComparators];
+
+static comparator_t *comparator_get(uint32_t hart, uint32_t comparator) {
+  CHECK(hart < kRvTimerServiceHarts && comparator < kRvTimerServiceComparators,
+        "no comparator %d on hart %d", comparator, hart);
+  return &comparators[hart][comparator];
+}
+
+static void comparator_arm(uint32_t hart, uint32_t comparator,
+                           uint64_t deadline) {
+  CHECK(dif_rv_timer_arm(service_timer, hart, comparator, deadline) ==
+        kDifRvTimerOk);
+  comparators[hart][comparator].deadline = deadline;
+}
+
+void rv_timer_service_init(uint64_t counter_freq_hz,
+                           dif_rv_timer_t *timer_out) {
+  CHECK(dif_rv_timer_init(
+            mmio_region_from_addr(TOP_ATHOS_RV_TIMER_BASE_ADDR),
+            (dif_rv_timer_config_t){
+                .hart_count = kRvTimerServiceHarts,
+                .comparator_count = kRvTimerServiceComparators,
+            },
+            timer_out) == kDifRvTimerOk);
+  service_timer = timer_out;
+
+  dif_rv_timer_tick_params_t tick_params;
+  CHECK(rv_timer_tick_params_get(counter_freq_hz, &tick_params) ==
+        kDifRvTimerApproximateTickParamsOk);
+  for (uint32_t hart = 0; hart < kRvTimerServiceHarts; ++hart) {
+    CHECK(dif_rv_timer_set_tick_params(timer_out, hart, tick_params) ==
+          kDifRvTimerOk);
+    for (uint32_t comparator = 0; comparator < kRvTimerServiceComparators;
+         ++comparator) {
+      comparators[hart][comparator] = (comparator_t){0};
+      comparator_arm(hart, comparator, UINT64_MAX);
+      CHECK(dif_rv_timer_irq_clear(timer_out, hart, comparator) ==
+            kDifRvTimerOk);
+      CHECK(dif_rv_timer_irq_enable(timer_out, hart, comparator,
+                                    kDifRvTimerEnabled) == kDifRvTimerOk);
+    }
+    CHECK(dif_rv_timer_counter_set_enabled(timer_out, hart,
+                                           kDifRvTimerEnabled) ==
+          kDifRvTimerOk);
+  }
+  irq_timer_ctrl(true);
+}
+
+void rv_timer_service_set_handler(uint32_t hart, uint32_t comparator,
+                                  rv_timer_service_fn_t fn, void *ctx) {
+  comparator_t *entry = comparator_get(hart, comparator);
+  uint32_t irq_state = irq_lock_acquire();
+  entry->fn = fn;
+  entry->ctx = ctx;
+  irq_lock_release(irq_state);
+}
+
+void rv_timer_service_arm(uint32_t hart, uint32_t comparator,
+                          uint64_t deadline) {
+  comparator_get(hart, comparator);
+  uint32_t irq_state = irq_lock_acquire();
+  comparator_arm(hart, comparator, deadline);
+  irq_lock_release(irq_state);
+}
+
+void rv_timer_service_disarm(uint32_t hart, uint32_t comparator) {
+  comparator_get(hart, comparator);
+  uint32_t irq_state = irq_lock_acquire();
+  comparator_arm(hart, comparator, UINT64_MAX);
+  CHECK(dif_rv_timer_irq_clear(service_timer, hart, comparator) ==
+        kDifRvTimerOk);
+  irq_lock_release(irq_state);
+}
+
+uint64_t rv_timer_service_now(uint32_t hart) {
+  uint64_t now;
+  CHECK(dif_rv_timer_counter_read(service_timer, hart, &now) ==
+        kDifRvTimerOk);
+  return now;
+}
+
+/**
+ * Finds the due comparator with the earliest deadline; returns false if none
+ * is due.
+ */
+static bool next_due(uint32_t *hart_out, uint32_t *comparator_out) {
+  bool found = false;
+  uint64_t earliest = UINT64_MAX;
+  for (uint32_t hart = 0; hart < kRvTimerServiceHarts; ++hart) {
+    for (uint32_t comparator = 0; comparator < kRvTimerServiceComparators;
+         ++comparator) {
+      bool pending;
+      CHECK(dif_rv_timer_irq_get(service_timer, hart, comparator, &pending) ==
+            kDifRvTimerOk);
+      uint64_t deadline = comparators[hart][comparator].deadline;
+      if (pending && (!found || deadline < earliest)) {
+        found = true;
+        earliest = deadline;
+        *hart_out = hart;
+        *comparator_out = comparator;
+      }
+    }
+  }
+  return found;
+}
+
+void rv_timer_service_handle_irq(void) {
+  uint32_t hart;
+  uint32_t comparator;
+  while (next_due(&hart, &comparator)) {
+    comparator_t *entry = &comparators[hart][comparator];
+    uint64_t deadline = entry->deadline;
+    comparator_arm(hart, comparator, UINT64_MAX);
+    CHECK(dif_rv_timer_irq_clear(service_timer, hart, comparator) ==
+          kDifRvTimerOk);
+    CHECK(entry->fn != NULL, "no handler for comparator %d of hart %d",
+          comparator, hart);
+    entry->fn(entry->ctx, deadline);
+  }
+}
@@ -0,0 +1,83 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_RV_TIMER_SERVICE_H_
+#define ATHOS_SW_DIF_SMOKETEST_RV_TIMER_SERVICE_H_
+
+#include <stdint.h>
+
+#include "dif/dif_rv_timer.h"
+
+#include "rv_timer_regs.h"  // Generated.
+
+/**
+ * One-shot deadlines on every comparator of the rv_timer.
+ *
+ * Every comparator of every hart the hardware has is its own deadline, with
+ * its own handler, so that separate classes of deadlines can be armed
+ * without multiplexing them in software. The timer interrupt must be routed
+ * to `rv_timer_service_handle_irq()`, typically as the body of
+ * `handler_irq_timer()`; the handlers are called from there, in deadline
+ * order when several comparators are due at once.
+ */
+
+enum {
+  kRvTimerServiceHarts = RV_TIMER_PARAM_N_HARTS,
+  kRvTimerServiceComparators = RV_TIMER_PARAM_N_TIMERS,
+};
+
+/**
+ * Called when a comparator reaches its deadline, from the timer interrupt.
+ *
+ * The comparator is disarmed when this is called, and may be armed again
+ * from here.
+ *
+ * @param ctx Context of the comparator.
+ * @param deadline Counter value the comparator was armed for.
+ */
+typedef void (*rv_timer_service_fn_t)(void *ctx, uint64_t deadline);
+
+/**
+ * Initialises the rv_timer with all its harts and comparators, sets every
+ * counter to `counter_freq_hz` and starts it, with every comparator
+ * disarmed, and enables the timer interrupt.
+ *
+ * @param counter_freq_hz Counter rate of every hart.
+ * @param[out] timer_out rv_timer handle; must outlive the service.
+ */
+void rv_timer_service_init(uint64_t counter_freq_hz,
+                           dif_rv_timer_t *timer_out);
+
+/**
+ * Sets the handler of `comparator` of `hart`.
+ *
+ * @param fn Called with `ctx` when the comparator reaches its deadline.
+ * @param ctx Passed to `fn`.
+ */
+void rv_timer_service_set_handler(uint32_t hart, uint32_t comparator,
+                                  rv_timer_service_fn_t fn, void *ctx);
+
+/**
+ * Arms `comparator` of `hart` for counter value `deadline`; one already in
+ * the past is due right away. Re-arms it if it is already armed.
+ */
+void rv_timer_service_arm(uint32_t hart, uint32_t comparator,
+                          uint64_t deadline);
+
+/**
+ * Disarms `comparator` of `hart`, if it is armed.
+ */
+void rv_timer_service_disarm(uint32_t hart, uint32_t comparator);
+
+/**
+ * Returns the counter value of `hart`.
+ */
+uint64_t rv_timer_service_now(uint32_t hart);
+
+/**
+ * Calls the handlers of every comparator that is due; to be called from
+ * `handler_irq_timer()`.
+ */
+void rv_timer_service_handle_irq(void);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_RV_TIMER_SERVICE_H_
@@ -0,0 +1,62 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "rv_timer_tick_params.h"
+
+#include "base/memory.h"
+#include "dif/device.h"
+
+/**
+ * Precomputed tick parameters: device, peripheral clock, counter rate,
+ * prescale and tick step. The counter steps by `tick_step` every
+ * `prescale + 1` peripheral cycles.
+ */
+#define TICK_PARAMS_TABLE(X)                             \
+  X(kDeviceFpgaNexysVideo, 2500000, 1000000, 4, 2)       \
+  X(kDeviceSimDV, 24000000, 1000000, 23, 1)              \
+  X(kDeviceSimVerilator, 125000, 1000000, 0, 8)
+
+#define TICK_PARAMS_CHECK(device, clock_freq_hz, counter_freq_hz, prescale, \
+                          tick_step)                                        \
+  RV_TIMER_TICK_PARAMS_CHECK(clock_freq_hz, counter_freq_hz, prescale,      \
+                             tick_step);
+TICK_PARAMS_TABLE(TICK_PARAMS_CHECK)
+
+typedef struct tick_params_entry {
+  device_type_t device;
+  uint64_t clock_freq_hz;
+  uint64_t counter_freq_hz;
+  dif_rv_timer_tick_params_t params;
+} tick_params_entry_t;
+
+#define TICK_PARAMS_ENTRY(device, clock_freq_hz, counter_freq_hz, \
+                          prescale_, tick_step_)                   \
+  {device, clock_freq_hz, counter_freq_hz,                         \
+   {.prescale = prescale_, .tick_step = tick_step_}},
+static const tick_params_entry_t kTickParams[] = {
+    TICK_PARAMS_TABLE(TICK_PARAMS_ENTRY)};
+
+dif_rv_timer_approximate_tick_params_result_t rv_timer_tick_params_get(
+    uint64_t counter_freq_hz, dif_rv_timer_tick_params_t *out) {
+  if (out == NULL) {
+    return kDifRvTimerApproximateTickParamsBadArg;
+  }
+
+  // A counter at the clock rate itself needs no division at all.
+  if (counter_freq_hz == kClockFreqPeripheralHz) {
+    *out = (dif_rv_timer_tick_params_t){.prescale = 0, .tick_step = 1};
+    return kDifRvTimerApproximateTickParamsOk;
+  }
+  for (size_t i = 0; i < ARRAYSIZE(kTickParams); ++i) {
+    const tick_params_entry_t *entry = &kTickParams[i];
+    if (entry->device == kDeviceType &&
+        entry->clock_freq_hz == kClockFreqPeripheralHz &&
+        entry->counter_freq_hz == counter_freq_hz) {
+      *out = entry->params;
+      return kDifRvTimerApproximateTickParamsOk;
+    }
+  }
+
+  return dif_rv_timer_approximate_tick_params(kClockFreqPeripheralHz,
+                                              counter_freq_hz, out);
+}
@@ -0,0 +1,68 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_RV_TIMER_TICK_PARAMS_H_
+#define ATHOS_SW_DIF_SMOKETEST_RV_TIMER_TICK_PARAMS_H_
+
+#include <stdint.h>
+
+#include "dif/dif_rv_timer.h"
+
+/**
+ * Precomputed rv_timer tick parameters.
+ *
+ * The peripheral clock and the counter rates used by the tests are fixed per
+ * device, so their tick parameters are precomputed, and checked at compile
+ * time, rather than derived by `dif_rv_timer_approximate_tick_params()`,
+ * whose 64-bit divisions are done in software on RV32.
+ */
+
+/**
+ * Largest rate error of precomputed tick parameters, in parts per million.
+ */
+#define RV_TIMER_TICK_PARAMS_TOLERANCE_PPM 100
+
+/**
+ * Rate error, in parts per million, of a counter off a `clock_freq_hz` clock
+ * that steps by `tick_step` every `prescale + 1` cycles, with respect to
+ * `counter_freq_hz`.
+ */
+#define RV_TIMER_TICK_PARAMS_ERROR_PPM(clock_freq_hz, counter_freq_hz,      \
+                                       prescale, tick_step)                 \
+  ((((uint64_t)(clock_freq_hz) * (tick_step) >                              \
+     (uint64_t)(counter_freq_hz) * ((prescale) + 1))                        \
+        ? (uint64_t)(clock_freq_hz) * (tick_step) -                         \
+              (uint64_t)(counter_freq_hz) * ((prescale) + 1)                \
+        : (uint64_t)(counter_freq_hz) * ((prescale) + 1) -                  \
+              (uint64_t)(clock_freq_hz) * (tick_step)) *                    \
+   1000000 / ((uint64_t)(counter_freq_hz) * ((prescale) + 1)))
+
+/**
+ * Fails the build unless the tick parameters fit the registers and are within
+ * `RV_TIMER_TICK_PARAMS_TOLERANCE_PPM` of `counter_freq_hz`.
+ */
+#define RV_TIMER_TICK_PARAMS_CHECK(clock_freq_hz, counter_freq_hz, prescale, \
+                                   tick_step)                                \
+  _Static_assert((prescale) >= 0 && (prescale) <= 0xfff &&                   \
+                     (tick_step) >= 1 && (tick_step) <= 0xff &&              \
+                     RV_TIMER_TICK_PARAMS_ERROR_PPM(                         \
+                         clock_freq_hz, counter_freq_hz, prescale,           \
+                         tick_step) <= RV_TIMER_TICK_PARAMS_TOLERANCE_PPM,   \
+                 "rv_timer tick parameters out of tolerance")
+
+/**
+ * Gets the tick parameters for a `counter_freq_hz` counter off the peripheral
+ * clock.
+ *
+ * The precomputed parameters are used when there are some for the device and
+ * rate, and `kClockFreqPeripheralHz` is the clock they were computed for;
+ * `dif_rv_timer_approximate_tick_params()` otherwise.
+ *
+ * @param counter_freq_hz Counter rate.
+ * @param[out] out Tick parameters.
+ * @return As `dif_rv_timer_approximate_tick_params()`.
+ */
+dif_rv_timer_approximate_tick_params_result_t rv_timer_tick_params_get(
+    uint64_t counter_freq_hz, dif_rv_timer_tick_params_t *out);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_RV_TIMER_TICK_PARAMS_H_
@@ -0,0 +1,67 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "sample_stats.h"
+
+/**
+ * Moves `samples[root]` down the max-heap of the first `count` samples until
+ * neither child is larger.
+ */
+static void sift_down(uint32_t *samples, size_t root, size_t count) {
+  uint32_t value = samples[root];
+  for (;;) {
+    size_t child = 2 * root + 1;
+    if (child >= count) {
+      break;
+    }
+    if (child + 1 < count && samples[child + 1] > samples[child]) {
+      ++child;
+    }
+    if (samples[child] <= value) {
+      break;
+    }
+    samples[root] = samples[child];
+    root = child;
+  }
+  samples[root] = value;
+}
+
+/**
+ * Heapsort; O(n log n) regardless of the input, in place and iterative.
+ */
+static void sort_samples(uint32_t *samples, size_t count) {
+  for (size_t i = count / 2; i > 0; --i) {
+    sift_down(samples, i - 1, count);
+  }
+  for (size_t end = count; end > 1; --end) {
+    uint32_t largest = samples[0];
+    samples[0] = samples[end - 1];
+    samples[end - 1] = largest;
+    sift_down(samples, 0, end - 1);
+  }
+}
+
+sample_stats_t sample_stats_compute(uint32_t *samples, size_t count) {
+  if (count == 0) {
+    return (sample_stats_t){0};
+  }
+
+  sort_samples(samples, count);
+
+  uint64_t sum = 0;
+  for (size_t i = 0; i < count; ++i) {
+    sum += samples[i];
+  }
+
+  // Nearest rank: the smallest sample that at least 99% of the samples do not
+  // exceed, i.e. rank ceil(0.99 * count).
+  size_t p99_rank = (count * 99 + 99) / 100;
+
+  return (sample_stats_t){
+      .count = count,
+      .min = samples[0],
+      .mean = (uint32_t)(sum / count),
+      .p99 = samples[p99_rank - 1],
+      .max = samples[count - 1],
+  };
+}
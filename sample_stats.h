@@ -0,0 +1,39 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_SAMPLE_STATS_H_
+#define ATHOS_SW_DIF_SMOKETEST_SAMPLE_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Summary of a set of samples, e.g. latencies in cycles.
+ */
+typedef struct sample_stats {
+  uint32_t count;
+  uint32_t min;
+  /**
+   * Arithmetic mean, rounded down.
+   */
+  uint32_t mean;
+  /**
+   * 99th percentile, by the nearest-rank method.
+   */
+  uint32_t p99;
+  uint32_t max;
+} sample_stats_t;
+
+/**
+ * Summarises `count` samples.
+ *
+ * Sorts `samples` in place; no allocation, and no recursion, so it may be used
+ * on large sample sets with a small stack.
+ *
+ * @param samples Samples to summarise; sorted in ascending order on return.
+ * @param count Number of samples; all fields of the result are zero if none.
+ * @return The summary.
+ */
+sample_stats_t sample_stats_compute(uint32_t *samples, size_t count);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_SAMPLE_STATS_H_
@@ -0,0 +1,48 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "tickless_idle.h"
+
+#include "dif/hart.h"
+#include "irq_lock.h"
+#include "timer_wheel.h"
+
+static tickless_idle_stats_t idle_stats;
+
+void tickless_idle_wait(irq_await_cond_fn_t cond, void *ctx) {
+  for (;;) {
+    uint32_t irq_state = irq_lock_acquire();
+    if (cond(ctx)) {
+      irq_lock_release(irq_state);
+      return;
+    }
+
+    // Without a deadline, only another interrupt ends the sleep.
+    uint64_t now = timer_wheel_now();
+    uint64_t next = timer_wheel_next_deadline();
+    if (next == UINT64_MAX) {
+      ++idle_stats.untimed_sleeps;
+    } else {
+      ++idle_stats.timed_sleeps;
+      uint64_t gap = next > now ? next - now : 0;
+      if (gap > idle_stats.max_gap_ticks) {
+        idle_stats.max_gap_ticks = gap;
+      }
+    }
+    // A pending interrupt ends the WFI even while masked; it is then taken
+    // on release.
+    wait_for_interrupt();
+    idle_stats.slept_ticks += timer_wheel_now() - now;
+    irq_lock_release(irq_state);
+  }
+}
+
+tickless_idle_stats_t tickless_idle_stats(bool reset) {
+  uint32_t irq_state = irq_lock_acquire();
+  tickless_idle_stats_t stats = idle_stats;
+  if (reset) {
+    idle_stats = (tickless_idle_stats_t){0};
+  }
+  irq_lock_release(irq_state);
+  return stats;
+}
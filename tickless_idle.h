@@ -0,0 +1,59 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_TICKLESS_IDLE_H_
+#define ATHOS_SW_DIF_SMOKETEST_TICKLESS_IDLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "irq_await.h"
+
+/**
+ * Tickless idle on top of the timer wheel.
+ *
+ * There is no periodic tick: when there is nothing to do, the hart sleeps in
+ * a WFI until the next software deadline of the wheel, whose comparator is
+ * already armed for it, or until any other interrupt. The counters tell how
+ * often, and for how long, the hart slept.
+ *
+ * pwrmgr low power is not used: a completed low power entry always leaves
+ * through a reset, even with main power kept on, which would lose the wheel
+ * and the state of the caller.
+ */
+
+typedef struct tickless_idle_stats {
+  /**
+   * Sleeps with a wheel deadline pending, and without any.
+   */
+  uint32_t timed_sleeps;
+  uint32_t untimed_sleeps;
+  /**
+   * Counter ticks spent asleep.
+   */
+  uint64_t slept_ticks;
+  /**
+   * Longest gap to the next deadline that was slept.
+   */
+  uint64_t max_gap_ticks;
+} tickless_idle_stats_t;
+
+/**
+ * Sleeps until `cond` holds, waking up for every interrupt in between; the
+ * timer wheel must be initialised.
+ *
+ * `cond` is checked with interrupts masked before every sleep, so that an
+ * interrupt that makes it true cannot be missed.
+ *
+ * @param cond Condition to wait for; set by an interrupt handler, typically a
+ *        timer of the wheel.
+ * @param ctx Passed to `cond`.
+ */
+void tickless_idle_wait(irq_await_cond_fn_t cond, void *ctx);
+
+/**
+ * Returns the sleep counters, and resets them if `reset` is set.
+ */
+tickless_idle_stats_t tickless_idle_stats(bool reset);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_TICKLESS_IDLE_H_
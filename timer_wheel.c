@@ -0,0 +1,328 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "timer_wheel.h"
+
+#include "dif/check.h"
+#include "dif/irq.h"
+#include "irq_lock.h"
+
+// `inline` definitions in the header need exactly one external definition.
+extern bool timer_wheel_is_active(const timer_wheel_timer_t *timer);
+
+enum {
+  /**
+   * `slot` of a timer on the overflow list.
+   */
+  kSlotOverflow = kTimerWheelLevels * kTimerWheelSlots,
+};
+
+static const dif_rv_timer_t *wheel_timer;
+static uint32_t wheel_hart;
+static uint32_t wheel_comparator;
+
+/**
+ * Counter value up to which the wheel has been processed; timers are placed
+ * relative to it.
+ */
+static uint64_t wheel_now;
+static timer_wheel_timer_t *slots[kTimerWheelLevels][kTimerWheelSlots];
+static uint64_t occupied[kTimerWheelLevels];
+static timer_wheel_timer_t *overflow;
+
+/**
+ * Comparator value, and whether the expired timers are being called; the
+ * comparator is re-armed once they all have been.
+ */
+static uint64_t armed;
+static bool servicing;
+
+static void list_push(timer_wheel_timer_t **head, timer_wheel_timer_t *timer) {
+  timer->next = *head;
+  if (timer->next != NULL) {
+    timer->next->pprev = &timer->next;
+  }
+  timer->pprev = head;
+  *head = timer;
+}
+
+static void list_unlink(timer_wheel_timer_t *timer) {
+  *timer->pprev = timer->next;
+  if (timer->next != NULL) {
+    timer->next->pprev = timer->pprev;
+  }
+  timer->next = NULL;
+  timer->pprev = NULL;
+}
+
+/**
+ * Moves the whole list at `*head` to `*list`.
+ */
+static void list_move(timer_wheel_timer_t **head, timer_wheel_timer_t **list) {
+  *list = *head;
+  *head = NULL;
+  if (*list != NULL) {
+    (*list)->pprev = list;
+  }
+}
+
+static uint32_t lowest_bit(uint64_t bits) {
+  uint32_t low = (uint32_t)bits;
+  return low != 0 ? __builtin_ctz(low)
+                  : 32 + __builtin_ctz((uint32_t)(bits >> 32));
+}
+
+static void wheel_insert(timer_wheel_timer_t *timer) {
+  uint64_t expiry = timer->expiry < wheel_now ? wheel_now : timer->expiry;
+  for (uint32_t level = 0; level < kTimerWheelLevels; ++level) {
+    uint32_t span_bits = kTimerWheelSlotBits * (level + 1);
+    if ((expiry >> span_bits) == (wheel_now >> span_bits)) {
+      uint32_t slot = (uint32_t)(expiry >> (kTimerWheelSlotBits * level)) &
+                      (kTimerWheelSlots - 1);
+      list_push(&slots[level][slot], timer);
+      occupied[level] |= 1ull << slot;
+      timer->slot = level * kTimerWheelSlots + slot;
+      return;
+    }
+  }
+  list_push(&overflow, timer);
+  timer->slot = kSlotOverflow;
+}
+
+static void wheel_remove(timer_wheel_timer_t *timer) {
+  list_unlink(timer);
+  if (timer->slot != kSlotOverflow) {
+    uint32_t level = timer->slot / kTimerWheelSlots;
+    uint32_t slot = timer->slot % kTimerWheelSlots;
+    if (slots[level][slot] == NULL) {
+      occupied[level] &= ~(1ull << slot);
+    }
+  }
+}
+
+/**
+ * Returns the first counter value, from `wheel_now` on, at which a slot has
+ * to be processed.
+ */
+static uint64_t wheel_next_event(void) {
+  for (uint32_t level = 0; level < kTimerWheelLevels; ++level) {
+    uint32_t slot_bits = kTimerWheelSlotBits * level;
+    uint32_t span_bits = slot_bits + kTimerWheelSlotBits;
+    uint32_t index =
+        (uint32_t)(wheel_now >> slot_bits) & (kTimerWheelSlots - 1);
+    uint64_t pending = occupied[level] & (UINT64_MAX << index);
+    if (pending != 0) {
+      return ((wheel_now >> span_bits) << span_bits) |
+             ((uint64_t)lowest_bit(pending) << slot_bits);
+    }
+  }
+  if (overflow != NULL) {
+    uint32_t span_bits = kTimerWheelSlotBits * kTimerWheelLevels;
+    return ((wheel_now >> span_bits) + 1) << span_bits;
+  }
+  return UINT64_MAX;
+}
+
+/**
+ * Re-inserts every timer of `*head`, relative to the current `wheel_now`.
+ */
+static void wheel_redistribute(timer_wheel_timer_t **head) {
+  timer_wheel_timer_t *list;
+  list_move(head, &list);
+  while (list != NULL) {
+    timer_wheel_timer_t *timer = list;
+    list_unlink(timer);
+    wheel_insert(timer);
+  }
+}
+
+/**
+ * Restarts an expired periodic timer one period after its expiry, skipping
+ * the periods that have already passed.
+ */
+static void periodic_restart(timer_wheel_timer_t *timer) {
+  uint64_t now = timer_wheel_now();
+  timer->expiry += timer->period;
+  while (timer->expiry <= now) {
+    timer->expiry += timer->period;
+    ++timer->overruns;
+  }
+  wheel_insert(timer);
+}
+
+/**
+ * Processes the slots due at `wheel_now`: the higher levels are redistributed
+ * first, top down, so that their timers due now end up on level 0, whose slot
+ * is then expired.
+ */
+static void wheel_process(void) {
+  uint64_t span_mask = (1ull << (kTimerWheelSlotBits * kTimerWheelLevels)) - 1;
+  if ((wheel_now & span_mask) == 0 && overflow != NULL) {
+    wheel_redistribute(&overflow);
+  }
+  for (uint32_t level = kTimerWheelLevels - 1; level > 0; --level) {
+    uint32_t slot_bits = kTimerWheelSlotBits * level;
+    if ((wheel_now & ((1ull << slot_bits) - 1)) != 0) {
+      continue;
+    }
+    uint32_t slot =
+        (uint32_t)(wheel_now >> slot_bits) & (kTimerWheelSlots - 1);
+    if ((occupied[level] & (1ull << slot)) != 0) {
+      occupied[level] &= ~(1ull << slot);
+      wheel_redistribute(&slots[level][slot]);
+    }
+  }
+
+  uint32_t slot = (uint32_t)wheel_now & (kTimerWheelSlots - 1);
+  if ((occupied[0] & (1ull << slot)) == 0) {
+    return;
+  }
+  occupied[0] &= ~(1ull << slot);
+  // A handler may start or cancel any timer, including the expired ones that
+  // have not been called yet, so they are taken off the list one at a time.
+  timer_wheel_timer_t *expired;
+  list_move(&slots[0][slot], &expired);
+  while (expired != NULL) {
+    timer_wheel_timer_t *timer = expired;
+    list_unlink(timer);
+    timer->fn(timer->ctx);
+    if (timer->period != 0 && !timer_wheel_is_active(timer)) {
+      periodic_restart(timer);
+    }
+  }
+}
+
+/**
+ * Processes every slot due up to `target`.
+ */
+static void wheel_advance(uint64_t target) {
+  for (;;) {
+    uint64_t next = wheel_next_event();
+    if (next > target) {
+      break;
+    }
+    wheel_now = next;
+    wheel_process();
+  }
+  // Nothing is due in between, so the placement of the timers stays valid.
+  if (target > wheel_now) {
+    wheel_now = target;
+  }
+}
+
+static void comparator_arm(uint64_t deadline) {
+  CHECK(dif_rv_timer_arm(wheel_timer, wheel_hart, wheel_comparator,
+                         deadline) == kDifRvTimerOk);
+  armed = deadline;
+}
+
+/**
+ * Arms the comparator for the next event, if it changed; an event that is
+ * already due raises the interrupt right away.
+ */
+static void wheel_rearm(void) {
+  if (servicing) {
+    return;
+  }
+  uint64_t next = wheel_next_event();
+  if (next != armed) {
+    comparator_arm(next);
+  }
+}
+
+void timer_wheel_init(const dif_rv_timer_t *timer, uint32_t hart,
+                      uint32_t comparator) {
+  wheel_timer = timer;
+  wheel_hart = hart;
+  wheel_comparator = comparator;
+  for (uint32_t level = 0; level < kTimerWheelLevels; ++level) {
+    for (uint32_t slot = 0; slot < kTimerWheelSlots; ++slot) {
+      slots[level][slot] = NULL;
+    }
+    occupied[level] = 0;
+  }
+  overflow = NULL;
+  servicing = false;
+
+  comparator_arm(UINT64_MAX);
+  CHECK(dif_rv_timer_irq_clear(timer, hart, comparator) == kDifRvTimerOk);
+  CHECK(dif_rv_timer_irq_enable(timer, hart, comparator,
+                                kDifRvTimerEnabled) == kDifRvTimerOk);
+  CHECK(dif_rv_timer_counter_set_enabled(timer, hart, kDifRvTimerEnabled) ==
+        kDifRvTimerOk);
+  wheel_now = timer_wheel_now();
+  irq_timer_ctrl(true);
+}
+
+void timer_wheel_timer_init(timer_wheel_timer_t *timer, timer_wheel_fn_t fn,
+                            void *ctx) {
+  *timer = (timer_wheel_timer_t){.fn = fn, .ctx = ctx};
+}
+
+static void timer_start(timer_wheel_timer_t *timer, uint64_t expiry,
+                        uint64_t period) {
+  uint32_t irq_state = irq_lock_acquire();
+  if (timer_wheel_is_active(timer)) {
+    wheel_remove(timer);
+  }
+  timer->expiry = expiry;
+  timer->period = period;
+  wheel_insert(timer);
+  wheel_rearm();
+  irq_lock_release(irq_state);
+}
+
+void timer_wheel_start_at(timer_wheel_timer_t *timer, uint64_t expiry) {
+  timer_start(timer, expiry, 0);
+}
+
+void timer_wheel_start(timer_wheel_timer_t *timer, uint64_t ticks) {
+  timer_wheel_start_at(timer, timer_wheel_now() + ticks);
+}
+
+void timer_wheel_start_periodic(timer_wheel_timer_t *timer,
+                                uint64_t first_expiry, uint64_t period) {
+  CHECK(period != 0, "periodic timer without a period");
+  timer_start(timer, first_expiry, period);
+}
+
+void timer_wheel_cancel(timer_wheel_timer_t *timer) {
+  uint32_t irq_state = irq_lock_acquire();
+  if (timer_wheel_is_active(timer)) {
+    wheel_remove(timer);
+    wheel_rearm();
+  }
+  timer->period = 0;
+  irq_lock_release(irq_state);
+}
+
+uint64_t timer_wheel_now(void) {
+  uint64_t now;
+  CHECK(dif_rv_timer_counter_read(wheel_timer, wheel_hart, &now) ==
+        kDifRvTimerOk);
+  return now;
+}
+
+uint64_t timer_wheel_next_deadline(void) {
+  uint32_t irq_state = irq_lock_acquire();
+  uint64_t next = wheel_next_event();
+  irq_lock_release(irq_state);
+  return next;
+}
+
+void timer_wheel_handle_irq(void) {
+  servicing = true;
+  for (;;) {
+    wheel_advance(timer_wheel_now());
+    uint64_t next = wheel_next_event();
+    comparator_arm(next);
+    CHECK(dif_rv_timer_irq_clear(wheel_timer, wheel_hart, wheel_comparator) ==
+          kDifRvTimerOk);
+    // Timers that became due while the others were called are processed
+    // right away, rather than through another interrupt.
+    if (next > timer_wheel_now()) {
+      break;
+    }
+  }
+  servicing = false;
+}
@@ -0,0 +1,160 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_TIMER_WHEEL_H_
+#define ATHOS_SW_DIF_SMOKETEST_TIMER_WHEEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dif/dif_rv_timer.h"
+
+/**
+ * Software timers on a single rv_timer comparator.
+ *
+ * Any number of timers are kept in a hierarchical timer wheel of
+ * `kTimerWheelLevels` levels of `kTimerWheelSlots` slots each, with one tick
+ * of the rv_timer counter as the resolution. Level `n` holds the timers that
+ * expire within the current span of `kTimerWheelSlots^(n+1)` ticks, in the
+ * slot of their `kTimerWheelSlots^n` tick sub-span; timers further out wait
+ * on an overflow list. Starting and cancelling a timer is a list insertion
+ * or removal, O(1); the next expiry is found from a slot occupancy bitmap per
+ * level.
+ *
+ * The comparator is always armed for the next expiry, or for the next slot
+ * of a higher level that has to be redistributed to the lower ones. Its
+ * interrupt must be routed to `timer_wheel_handle_irq()`, typically as the
+ * body of `handler_irq_timer()`; expired timers are called from there.
+ *
+ * A periodic timer is restarted one period after its previous expiry, not
+ * after the time its interrupt was taken, so that interrupt latency does not
+ * accumulate into drift. Periods that have already passed by then are
+ * skipped, and counted as overruns.
+ */
+
+enum {
+  /**
+   * Bits of the expiry per level, and slots per level.
+   */
+  kTimerWheelSlotBits = 6,
+  kTimerWheelSlots = 1 << kTimerWheelSlotBits,
+  kTimerWheelLevels = 4,
+};
+
+/**
+ * Called when a timer expires, from the timer interrupt.
+ *
+ * The timer is no longer active when this is called, and may be started
+ * again from here. A periodic timer is restarted for its next period once
+ * this returns, unless it was started or cancelled from here.
+ *
+ * @param ctx Context of the timer.
+ */
+typedef void (*timer_wheel_fn_t)(void *ctx);
+
+/**
+ * A software timer; owned by the caller, and linked into the wheel while
+ * active.
+ */
+typedef struct timer_wheel_timer {
+  /**
+   * List links; `pprev` points at the link that points at this timer, and is
+   * NULL while the timer is inactive.
+   */
+  struct timer_wheel_timer *next;
+  struct timer_wheel_timer **pprev;
+  /**
+   * Level and slot the timer is linked into.
+   */
+  uint32_t slot;
+  /**
+   * Counter value the timer expires at.
+   */
+  uint64_t expiry;
+  /**
+   * Period of a periodic timer, or 0 for a one-shot timer.
+   */
+  uint64_t period;
+  /**
+   * Periods a periodic timer skipped because they had already passed when it
+   * was restarted; never reset by the wheel.
+   */
+  uint32_t overruns;
+  timer_wheel_fn_t fn;
+  void *ctx;
+} timer_wheel_timer_t;
+
+/**
+ * Sets up the wheel on `comparator` of `hart`, with no timers, and enables
+ * the timer interrupt.
+ *
+ * The tick parameters of `hart` are left to the caller; its counter is
+ * started if it is not running yet.
+ *
+ * @param timer Initialised rv_timer; must outlive the wheel.
+ * @param hart Hart whose counter is used.
+ * @param comparator Comparator of `hart` dedicated to the wheel.
+ */
+void timer_wheel_init(const dif_rv_timer_t *timer, uint32_t hart,
+                      uint32_t comparator);
+
+/**
+ * Initialises `timer` as inactive, with its expiry handler.
+ *
+ * @param timer Timer to initialise.
+ * @param fn Called with `ctx` when the timer expires.
+ * @param ctx Passed to `fn`.
+ */
+void timer_wheel_timer_init(timer_wheel_timer_t *timer, timer_wheel_fn_t fn,
+                            void *ctx);
+
+/**
+ * Starts `timer` to expire at counter value `expiry`; one already in the past
+ * expires right away. Restarts it if it is already active.
+ */
+void timer_wheel_start_at(timer_wheel_timer_t *timer, uint64_t expiry);
+
+/**
+ * Starts `timer` to expire `ticks` counter ticks from now.
+ */
+void timer_wheel_start(timer_wheel_timer_t *timer, uint64_t ticks);
+
+/**
+ * Starts `timer` to expire every `period` counter ticks, the first time at
+ * counter value `first_expiry`. Restarts it if it is already active.
+ *
+ * @param period Must not be 0.
+ */
+void timer_wheel_start_periodic(timer_wheel_timer_t *timer,
+                                uint64_t first_expiry, uint64_t period);
+
+/**
+ * Stops `timer`, if it is active; a periodic timer is not restarted anymore.
+ */
+void timer_wheel_cancel(timer_wheel_timer_t *timer);
+
+/**
+ * Returns whether `timer` is started and has not expired or been cancelled.
+ */
+inline bool timer_wheel_is_active(const timer_wheel_timer_t *timer) {
+  return timer->pprev != NULL;
+}
+
+/**
+ * Returns the current counter value.
+ */
+uint64_t timer_wheel_now(void);
+
+/**
+ * Returns the earliest counter value at which the wheel needs servicing, i.e.
+ * no later than the next expiry, or `UINT64_MAX` if no timer is active.
+ */
+uint64_t timer_wheel_next_deadline(void);
+
+/**
+ * Calls the expired timers and re-arms the comparator; to be called from
+ * `handler_irq_timer()`.
+ */
+void timer_wheel_handle_irq(void);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_TIMER_WHEEL_H_
@@ -0,0 +1,93 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "uart_burst.h"
+
+#include "base/mmio.h"
+
+#include "uart_regs.h"  // Generated.
+
+dif_uart_result_t uart_burst_fill(const dif_uart_t *uart, const uint8_t *data,
+                                  size_t bytes_requested,
+                                  size_t *bytes_written) {
+  if (uart == NULL || data == NULL) {
+    return kDifUartBadArg;
+  }
+
+  // The only status read of the burst.
+  size_t space;
+  dif_uart_result_t result = dif_uart_tx_bytes_available(uart, &space);
+  if (result != kDifUartOk) {
+    return result;
+  }
+
+  size_t len = bytes_requested < space ? bytes_requested : space;
+  for (size_t i = 0; i < len; ++i) {
+    mmio_region_write32(uart->params.base_addr, UART_WDATA_REG_OFFSET, data[i]);
+  }
+
+  if (bytes_written != NULL) {
+    *bytes_written = len;
+  }
+
+  return kDifUartOk;
+}
+
+dif_uart_result_t uart_burst_drain(const dif_uart_t *uart,
+                                   size_t bytes_requested, uint8_t *data,
+                                   size_t *bytes_read) {
+  if (uart == NULL || data == NULL) {
+    return kDifUartBadArg;
+  }
+
+  // The only status read of the burst.
+  size_t avail;
+  dif_uart_result_t result = dif_uart_rx_bytes_available(uart, &avail);
+  if (result != kDifUartOk) {
+    return result;
+  }
+
+  size_t len = bytes_requested < avail ? bytes_requested : avail;
+  for (size_t i = 0; i < len; ++i) {
+    data[i] = (uint8_t)mmio_region_read32(uart->params.base_addr,
+                                          UART_RDATA_REG_OFFSET);
+  }
+
+  if (bytes_read != NULL) {
+    *bytes_read = len;
+  }
+
+  return kDifUartOk;
+}
+
+dif_uart_result_t uart_burst_send(const dif_uart_t *uart, const uint8_t *data,
+                                  size_t bytes_requested) {
+  size_t sent = 0;
+  while (sent < bytes_requested) {
+    size_t written;
+    dif_uart_result_t result =
+        uart_burst_fill(uart, &data[sent], bytes_requested - sent, &written);
+    if (result != kDifUartOk) {
+      return result;
+    }
+    sent += written;
+  }
+
+  return kDifUartOk;
+}
+
+dif_uart_result_t uart_burst_receive(const dif_uart_t *uart,
+                                     size_t bytes_requested, uint8_t *data) {
+  size_t received = 0;
+  while (received < bytes_requested) {
+    size_t read;
+    dif_uart_result_t result = uart_burst_drain(
+        uart, bytes_requested - received, &data[received], &read);
+    if (result != kDifUartOk) {
+      return result;
+    }
+    received += read;
+  }
+
+  return kDifUartOk;
+}
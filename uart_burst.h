@@ -0,0 +1,75 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_UART_BURST_H_
+#define ATHOS_SW_DIF_SMOKETEST_UART_BURST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dif/dif_uart.h"
+
+/**
+ * FIFO depth aware burst transfers.
+ *
+ * Unlike `dif_uart_bytes_send()` and friends, which check the FIFO status
+ * before every byte, these functions read the FIFO level once and then move
+ * as many bytes as fit into / are held by the FIFO, with a single data
+ * register access per byte.
+ */
+
+/**
+ * Writes as many bytes of `data` as currently fit into the TX FIFO.
+ *
+ * Does not block.
+ *
+ * @param uart A UART handle.
+ * @param data Data to be written.
+ * @param bytes_requested Number of bytes requested to be written.
+ * @param[out] bytes_written Number of bytes written (optional).
+ * @return The result of the operation.
+ */
+dif_uart_result_t uart_burst_fill(const dif_uart_t *uart, const uint8_t *data,
+                                  size_t bytes_requested,
+                                  size_t *bytes_written);
+
+/**
+ * Reads as many bytes as are currently held by the RX FIFO, up to
+ * `bytes_requested`.
+ *
+ * Does not block.
+ *
+ * @param uart A UART handle.
+ * @param bytes_requested Maximum number of bytes to read.
+ * @param[out] data Buffer for the received bytes.
+ * @param[out] bytes_read Number of bytes read (optional).
+ * @return The result of the operation.
+ */
+dif_uart_result_t uart_burst_drain(const dif_uart_t *uart,
+                                   size_t bytes_requested, uint8_t *data,
+                                   size_t *bytes_read);
+
+/**
+ * Sends `bytes_requested` bytes, blocking until all of them are in the TX
+ * FIFO.
+ *
+ * @param uart A UART handle.
+ * @param data Data to be sent.
+ * @param bytes_requested Number of bytes to send.
+ * @return The result of the operation.
+ */
+dif_uart_result_t uart_burst_send(const dif_uart_t *uart, const uint8_t *data,
+                                  size_t bytes_requested);
+
+/**
+ * Receives `bytes_requested` bytes, blocking until all of them have arrived.
+ *
+ * @param uart A UART handle.
+ * @param bytes_requested Number of bytes to receive.
+ * @param[out] data Buffer for the received bytes.
+ * @return The result of the operation.
+ */
+dif_uart_result_t uart_burst_receive(const dif_uart_t *uart,
+                                     size_t bytes_requested, uint8_t *data);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_UART_BURST_H_
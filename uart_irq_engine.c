@@ -0,0 +1,147 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "uart_irq_engine.h"
+
+#include "dif/check.h"
+#include "dif/log.h"
+#include "dif/test_status.h"
+#include "irq_lock.h"
+#include "uart_burst.h"
+
+enum {
+  /**
+   * Bytes moved between a ring and a FIFO in one go; matches the depth of the
+   * UART FIFOs.
+   */
+  kEngineChunkBytes = 32,
+};
+
+/**
+ * Moves as many bytes from the TX ring into the TX FIFO as the FIFO can take.
+ *
+ * Consumer side of the TX ring; called from the ISR, or from the main program
+ * with interrupts masked.
+ */
+static void engine_fill_tx(uart_irq_engine_t *engine) {
+  for (;;) {
+    uint8_t chunk[kEngineChunkBytes];
+    size_t len = ring_buffer_peek(&engine->tx, chunk, sizeof(chunk));
+    if (len == 0) {
+      return;
+    }
+
+    size_t written;
+    CHECK(uart_burst_fill(engine->uart, chunk, len, &written) == kDifUartOk);
+    ring_buffer_discard(&engine->tx, written);
+    if (written < len) {
+      // TX FIFO is full.
+      return;
+    }
+  }
+}
+
+/**
+ * Moves every byte currently in the RX FIFO into the RX ring.
+ *
+ * Producer side of the RX ring; called from the ISR, or from the main program
+ * with interrupts masked.
+ */
+static void engine_drain_rx(uart_irq_engine_t *engine) {
+  for (;;) {
+    uint8_t chunk[kEngineChunkBytes];
+    size_t read;
+    CHECK(uart_burst_drain(engine->uart, sizeof(chunk), chunk, &read) ==
+          kDifUartOk);
+
+    size_t stored = ring_buffer_push(&engine->rx, chunk, read);
+    engine->rx_dropped += read - stored;
+    if (read < sizeof(chunk)) {
+      // RX FIFO is empty.
+      return;
+    }
+  }
+}
+
+void uart_irq_engine_init(uart_irq_engine_t *engine, const dif_uart_t *uart,
+                          uint8_t *tx_storage, size_t tx_size,
+                          uint8_t *rx_storage, size_t rx_size) {
+  engine->uart = uart;
+  ring_buffer_init(&engine->tx, tx_storage, tx_size);
+  ring_buffer_init(&engine->rx, rx_storage, rx_size);
+  engine->rx_dropped = 0;
+  engine->irq_count = 0;
+
+  // Refill the TX FIFO once it is half empty, and drain the RX FIFO once it is
+  // half full, so that neither side runs dry / overflows while the other half
+  // is being serviced.
+  CHECK(dif_uart_watermark_tx_set(uart, kDifUartWatermarkTxByte16) ==
+        kDifUartOk);
+  CHECK(dif_uart_watermark_rx_set(uart, kDifUartWatermarkRxByte16) ==
+        kDifUartOk);
+
+  CHECK(dif_uart_irq_set_enabled(uart, kDifUartIrqTxWatermark,
+                                 kDifUartToggleEnabled) == kDifUartOk,
+        "TX FIFO dips below its watermark IRQ enable failed!");
+  CHECK(dif_uart_irq_set_enabled(uart, kDifUartIrqTxEmpty,
+                                 kDifUartToggleEnabled) == kDifUartOk,
+        "TX empty IRQ enable failed!");
+  CHECK(dif_uart_irq_set_enabled(uart, kDifUartIrqRxWatermark,
+                                 kDifUartToggleEnabled) == kDifUartOk,
+        "RX FIFO goes over its watermark IRQ enable failed!");
+}
+
+size_t uart_irq_engine_write(uart_irq_engine_t *engine, const uint8_t *data,
+                             size_t len) {
+  size_t queued = ring_buffer_push(&engine->tx, data, len);
+
+  // The TX watermark IRQ only fires when the FIFO level crosses the
+  // watermark, so an idle FIFO has to be primed from here.
+  uint32_t irq_state = irq_lock_acquire();
+  engine_fill_tx(engine);
+  irq_lock_release(irq_state);
+
+  return queued;
+}
+
+size_t uart_irq_engine_read(uart_irq_engine_t *engine, uint8_t *data,
+                            size_t len) {
+  size_t got = ring_buffer_pop(&engine->rx, data, len);
+
+  // The tail of a transfer may stay below the RX watermark, in which case no
+  // IRQ will ever collect it.
+  if (got < len) {
+    uint32_t irq_state = irq_lock_acquire();
+    engine_drain_rx(engine);
+    irq_lock_release(irq_state);
+    got += ring_buffer_pop(&engine->rx, data + got, len - got);
+  }
+
+  return got;
+}
+
+bool uart_irq_engine_tx_done(const uart_irq_engine_t *engine) {
+  return ring_buffer_used(&engine->tx) == 0;
+}
+
+void uart_irq_engine_handle_irq(uart_irq_engine_t *engine, dif_uart_irq_t irq) {
+  ++engine->irq_count;
+
+  // Watermark IRQs are events; acknowledge before servicing, so that a
+  // crossing which happens while servicing is not lost.
+  CHECK(dif_uart_irq_acknowledge(engine->uart, irq) == kDifUartOk,
+        "ISR failed to clear IRQ!");
+
+  switch (irq) {
+    case kDifUartIrqTxWatermark:
+    case kDifUartIrqTxEmpty:
+      engine_fill_tx(engine);
+      break;
+    case kDifUartIrqRxWatermark:
+      engine_drain_rx(engine);
+      break;
+    default:
+      LOG_FATAL("UART IRQ %d is not handled by the engine!", irq);
+      test_status_set(kTestStatusFailed);
+  }
+}
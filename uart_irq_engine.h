@@ -0,0 +1,95 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_UART_IRQ_ENGINE_H_
+#define ATHOS_SW_DIF_SMOKETEST_UART_IRQ_ENGINE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dif/dif_uart.h"
+#include "ring_buffer.h"
+
+/**
+ * Interrupt driven UART transfer engine.
+ *
+ * The main program only moves data between its own buffers and two RAM ring
+ * buffers; the TX watermark / TX empty interrupts refill the TX FIFO from the
+ * TX ring and the RX watermark interrupt drains the RX FIFO into the RX ring.
+ * The main program therefore never stalls on a FIFO status read per byte.
+ */
+typedef struct uart_irq_engine {
+  const dif_uart_t *uart;
+  ring_buffer_t tx;
+  ring_buffer_t rx;
+  /**
+   * Bytes that were received but could not be stored, because the RX ring
+   * was full.
+   */
+  volatile uint32_t rx_dropped;
+  /**
+   * Number of UART interrupts serviced by the engine.
+   */
+  volatile uint32_t irq_count;
+} uart_irq_engine_t;
+
+/**
+ * Initialises `engine`, and configures the watermarks and interrupts of
+ * `uart` for interrupt driven operation.
+ *
+ * The UART must have been initialised and configured by the caller, and the
+ * caller is responsible for routing the UART interrupts through the PLIC to
+ * `uart_irq_engine_handle_irq()`.
+ *
+ * @param engine Engine to initialise.
+ * @param uart UART instance driven by the engine.
+ * @param tx_storage TX ring storage, size must be a power of two.
+ * @param tx_size Size of `tx_storage` in bytes.
+ * @param rx_storage RX ring storage, size must be a power of two.
+ * @param rx_size Size of `rx_storage` in bytes.
+ */
+void uart_irq_engine_init(uart_irq_engine_t *engine, const dif_uart_t *uart,
+                          uint8_t *tx_storage, size_t tx_size,
+                          uint8_t *rx_storage, size_t rx_size);
+
+/**
+ * Queues up to `len` bytes for transmission.
+ *
+ * Does not block; the bytes that do not fit into the TX ring are not queued.
+ * Must not be called from an ISR, as it is the only producer of the TX ring.
+ *
+ * @return The number of bytes queued.
+ */
+size_t uart_irq_engine_write(uart_irq_engine_t *engine, const uint8_t *data,
+                             size_t len);
+
+/**
+ * Retrieves up to `len` received bytes.
+ *
+ * Does not block. Bytes that are still in the RX FIFO below the RX watermark
+ * are collected as well, once the RX ring has run dry. Must not be called from
+ * an ISR, as it is the only consumer of the RX ring.
+ *
+ * @return The number of bytes retrieved.
+ */
+size_t uart_irq_engine_read(uart_irq_engine_t *engine, uint8_t *data,
+                            size_t len);
+
+/**
+ * Returns true if every queued byte has been handed to the TX FIFO.
+ */
+bool uart_irq_engine_tx_done(const uart_irq_engine_t *engine);
+
+/**
+ * Services a UART interrupt on behalf of the engine.
+ *
+ * Must be called from the external interrupt handler for every interrupt of
+ * the engine's UART. Acknowledges the interrupt.
+ *
+ * @param engine Engine that owns the interrupting UART.
+ * @param irq The UART interrupt that has fired.
+ */
+void uart_irq_engine_handle_irq(uart_irq_engine_t *engine, dif_uart_irq_t irq);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_UART_IRQ_ENGINE_H_
@@ -0,0 +1,109 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "uart_multi.h"
+
+#include "base/memory.h"
+#include "base/mmio.h"
+#include "dif/check.h"
+#include "plic_batch.h"
+
+/**
+ * UART instances of the top; instances the top does not have are left out.
+ */
+static const uart_instance_t kUartInstances[] = {
+#ifdef TOP_ATHOS_UART0_BASE_ADDR
+    {
+        .base_addr = TOP_ATHOS_UART0_BASE_ADDR,
+        .peripheral = kTopAthosPlicPeripheralUart0,
+        .first_irq = kTopAthosPlicIrqIdUart0TxWatermark,
+    },
+#endif
+#ifdef TOP_ATHOS_UART1_BASE_ADDR
+    {
+        .base_addr = TOP_ATHOS_UART1_BASE_ADDR,
+        .peripheral = kTopAthosPlicPeripheralUart1,
+        .first_irq = kTopAthosPlicIrqIdUart1TxWatermark,
+    },
+#endif
+#ifdef TOP_ATHOS_UART2_BASE_ADDR
+    {
+        .base_addr = TOP_ATHOS_UART2_BASE_ADDR,
+        .peripheral = kTopAthosPlicPeripheralUart2,
+        .first_irq = kTopAthosPlicIrqIdUart2TxWatermark,
+    },
+#endif
+#ifdef TOP_ATHOS_UART3_BASE_ADDR
+    {
+        .base_addr = TOP_ATHOS_UART3_BASE_ADDR,
+        .peripheral = kTopAthosPlicPeripheralUart3,
+        .first_irq = kTopAthosPlicIrqIdUart3TxWatermark,
+    },
+#endif
+};
+
+/**
+ * UART interrupts serviced by the engines.
+ */
+static const dif_uart_irq_t kEngineIrqs[] = {
+    kDifUartIrqTxWatermark,
+    kDifUartIrqRxWatermark,
+    kDifUartIrqTxEmpty,
+};
+
+_Static_assert(ARRAYSIZE(kUartInstances) <= kUartMultiMaxPorts,
+               "kUartMultiMaxPorts is too small for the top");
+
+static uart_multi_port_t ports[ARRAYSIZE(kUartInstances)];
+
+size_t uart_multi_port_count(void) { return ARRAYSIZE(kUartInstances); }
+
+uart_multi_port_t *uart_multi_port(size_t index) {
+  CHECK(index < ARRAYSIZE(ports), "No UART instance %d!", index);
+  return &ports[index];
+}
+
+void uart_multi_init(const dif_plic_t *plic, dif_plic_target_t target,
+                     dif_uart_config_t config) {
+  for (size_t i = 0; i < ARRAYSIZE(ports); ++i) {
+    uart_multi_port_t *port = &ports[i];
+    port->instance = &kUartInstances[i];
+
+    CHECK(dif_uart_init(
+              (dif_uart_params_t){
+                  .base_addr = mmio_region_from_addr(port->instance->base_addr),
+              },
+              &port->uart) == kDifUartOk);
+    CHECK(dif_uart_configure(&port->uart, config) == kDifUartConfigOk,
+          "UART config failed!");
+    CHECK(dif_uart_fifo_reset(&port->uart, kDifUartFifoResetAll) ==
+          kDifUartOk);
+    uart_irq_engine_init(&port->engine, &port->uart, port->tx_ring,
+                         sizeof(port->tx_ring), port->rx_ring,
+                         sizeof(port->rx_ring));
+
+    plic_batch_entry_t irqs[ARRAYSIZE(kEngineIrqs)];
+    for (int j = 0; j < ARRAYSIZE(kEngineIrqs); ++j) {
+      irqs[j] = (plic_batch_entry_t){
+          .irq = port->instance->first_irq + kEngineIrqs[j],
+          .priority = kDifPlicMaxPriority,
+          .trigger = kDifPlicIrqTriggerLevel,
+          .target = target,
+      };
+    }
+    CHECK(plic_batch_configure(plic, irqs, ARRAYSIZE(irqs)) == kDifPlicOk,
+          "PLIC IRQ configuration failed!");
+  }
+}
+
+bool uart_multi_handle_irq(dif_plic_irq_id_t irq_id) {
+  for (size_t i = 0; i < ARRAYSIZE(ports); ++i) {
+    dif_plic_irq_id_t first = kUartInstances[i].first_irq;
+    if (irq_id >= first && irq_id <= first + kDifUartIrqLast) {
+      uart_irq_engine_handle_irq(&ports[i].engine,
+                                 (dif_uart_irq_t)(irq_id - first));
+      return true;
+    }
+  }
+  return false;
+}
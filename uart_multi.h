@@ -0,0 +1,86 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_UART_MULTI_H_
+#define ATHOS_SW_DIF_SMOKETEST_UART_MULTI_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dif/dif_plic.h"
+#include "dif/dif_uart.h"
+#include "uart_irq_engine.h"
+
+#include "top/sw/autogen/top_athos.h"  // Generated.
+
+/**
+ * Every UART instance of the top, each driven by its own interrupt driven
+ * engine, behind one shared PLIC interrupt path.
+ */
+
+enum {
+  /**
+   * Size of the TX and RX rings of each port.
+   */
+  kUartMultiRingBytes = 256,
+  /**
+   * Upper bound of the number of UART instances, for sizing arrays.
+   */
+  kUartMultiMaxPorts = 4,
+};
+
+/**
+ * A UART instance of the top.
+ */
+typedef struct uart_instance {
+  uintptr_t base_addr;
+  top_athos_plic_peripheral_t peripheral;
+  /**
+   * PLIC IRQ ID of the instance's TX watermark interrupt; the IDs of its other
+   * interrupts follow in `dif_uart_irq_t` order.
+   */
+  dif_plic_irq_id_t first_irq;
+} uart_instance_t;
+
+typedef struct uart_multi_port {
+  const uart_instance_t *instance;
+  dif_uart_t uart;
+  uart_irq_engine_t engine;
+  uint8_t tx_ring[kUartMultiRingBytes];
+  uint8_t rx_ring[kUartMultiRingBytes];
+} uart_multi_port_t;
+
+/**
+ * Returns the number of UART instances in the top.
+ */
+size_t uart_multi_port_count(void);
+
+/**
+ * Returns the port of the `index`th UART instance.
+ */
+uart_multi_port_t *uart_multi_port(size_t index);
+
+/**
+ * Initialises and configures every UART instance, starts its engine, and
+ * routes the engine's interrupts to `target` through `plic`.
+ *
+ * The PLIC target threshold and the Ibex interrupt enables are left to the
+ * caller.
+ *
+ * @param plic PLIC to route the UART interrupts through.
+ * @param target PLIC target servicing the interrupts.
+ * @param config Configuration applied to every UART.
+ */
+void uart_multi_init(const dif_plic_t *plic, dif_plic_target_t target,
+                     dif_uart_config_t config);
+
+/**
+ * Hands a claimed PLIC interrupt to the engine of the UART it belongs to.
+ *
+ * @param irq_id Claimed PLIC IRQ ID.
+ * @return False if `irq_id` does not belong to any UART instance.
+ */
+bool uart_multi_handle_irq(dif_plic_irq_id_t irq_id);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_UART_MULTI_H_
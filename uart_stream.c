@@ -0,0 +1,196 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#include "uart_stream.h"
+
+#include "base/mmio.h"
+#include "dif/check.h"
+#include "dif/log.h"
+#include "dif/test_status.h"
+#include "uart_burst.h"
+
+#include "uart_regs.h"  // Generated.
+
+enum {
+  /**
+   * Bytes drained per callback when no buffer is queued; matches the depth of
+   * the UART FIFOs.
+   */
+  kUartStreamChunkBytes = 32,
+};
+
+/**
+ * Enables the RX timeout, or disables it if `bits` is zero.
+ */
+static void stream_rx_timeout_set(const dif_uart_t *uart, uint32_t bits) {
+  uint32_t reg = 0;
+  if (bits != 0) {
+    reg = (bits & UART_TIMEOUT_CTRL_VAL_MASK) << UART_TIMEOUT_CTRL_VAL_OFFSET;
+    reg |= 1u << UART_TIMEOUT_CTRL_EN_BIT;
+  }
+  mmio_region_write32(uart->params.base_addr, UART_TIMEOUT_CTRL_REG_OFFSET,
+                      reg);
+}
+
+/**
+ * Drains up to `limit` bytes of the RX FIFO into the queued buffers, or into
+ * the callback.
+ */
+static void stream_drain(uart_stream_rx_t *stream, size_t limit) {
+  while (limit > 0) {
+    size_t read;
+
+    if (stream->tail != stream->head) {
+      uart_stream_buffer_t *buffer =
+          &stream->buffers[stream->tail % kUartStreamMaxBuffers];
+      size_t wanted = buffer->size - stream->fill;
+      if (wanted > limit) {
+        wanted = limit;
+      }
+      CHECK(uart_burst_drain(stream->uart, wanted, &buffer->data[stream->fill],
+                             &read) == kDifUartOk);
+      stream->fill += read;
+      stream->received += read;
+      stream->packet_bytes += read;
+      limit -= read;
+      if (stream->fill < buffer->size) {
+        // RX FIFO is empty, or `limit` is reached.
+        return;
+      }
+
+      stream->fill = 0;
+      ++stream->tail;
+      stream->callback(stream->ctx, buffer->data, buffer->size);
+    } else {
+      uint8_t chunk[kUartStreamChunkBytes];
+      size_t wanted = limit < sizeof(chunk) ? limit : sizeof(chunk);
+      CHECK(uart_burst_drain(stream->uart, wanted, chunk, &read) ==
+            kDifUartOk);
+      if (read == 0) {
+        return;
+      }
+
+      stream->received += read;
+      stream->packet_bytes += read;
+      limit -= read;
+      stream->callback(stream->ctx, chunk, read);
+      if (read < wanted) {
+        // RX FIFO is empty.
+        return;
+      }
+    }
+  }
+}
+
+/**
+ * Ends the packet in progress, if any bytes of it have been received.
+ */
+static void stream_end_packet(uart_stream_rx_t *stream) {
+  if (stream->packet_bytes == 0) {
+    return;
+  }
+  stream->packet_bytes = 0;
+  ++stream->packets;
+
+  if (stream->fill != 0) {
+    uart_stream_buffer_t *buffer =
+        &stream->buffers[stream->tail % kUartStreamMaxBuffers];
+    size_t len = stream->fill;
+    stream->fill = 0;
+    ++stream->tail;
+    stream->callback(stream->ctx, buffer->data, len);
+  } else {
+    stream->callback(stream->ctx, NULL, 0);
+  }
+}
+
+void uart_stream_rx_init(uart_stream_rx_t *stream, const dif_uart_t *uart,
+                         uint32_t rx_timeout_bits,
+                         uart_stream_rx_cb_t callback, void *ctx) {
+  CHECK(callback != NULL, "UART stream needs a callback!");
+
+  stream->uart = uart;
+  stream->callback = callback;
+  stream->ctx = ctx;
+  stream->head = 0;
+  stream->tail = 0;
+  stream->fill = 0;
+  stream->received = 0;
+  stream->irq_count = 0;
+  stream->packet_mode = false;
+  stream->packet_bytes = 0;
+  stream->packets = 0;
+
+  // Drain once the RX FIFO is half full, so that the other half absorbs the
+  // interrupt latency.
+  CHECK(dif_uart_watermark_rx_set(uart, kDifUartWatermarkRxByte16) ==
+        kDifUartOk);
+  stream_rx_timeout_set(uart, rx_timeout_bits);
+
+  CHECK(dif_uart_irq_set_enabled(uart, kDifUartIrqRxWatermark,
+                                 kDifUartToggleEnabled) == kDifUartOk,
+        "RX FIFO goes over its watermark IRQ enable failed!");
+  CHECK(dif_uart_irq_set_enabled(uart, kDifUartIrqRxTimeout,
+                                 kDifUartToggleEnabled) == kDifUartOk,
+        "RX FIFO timeout expires before it is emptied IRQ enable failed!");
+}
+
+void uart_stream_rx_stop(uart_stream_rx_t *stream) {
+  CHECK(dif_uart_irq_set_enabled(stream->uart, kDifUartIrqRxWatermark,
+                                 kDifUartToggleDisabled) == kDifUartOk);
+  CHECK(dif_uart_irq_set_enabled(stream->uart, kDifUartIrqRxTimeout,
+                                 kDifUartToggleDisabled) == kDifUartOk);
+  stream_rx_timeout_set(stream->uart, 0);
+}
+
+void uart_stream_rx_set_packet_mode(uart_stream_rx_t *stream, bool enabled) {
+  stream->packet_mode = enabled;
+}
+
+bool uart_stream_rx_submit(uart_stream_rx_t *stream, uint8_t *buffer,
+                           size_t size) {
+  if (stream->head - stream->tail == kUartStreamMaxBuffers) {
+    return false;
+  }
+
+  stream->buffers[stream->head % kUartStreamMaxBuffers] =
+      (uart_stream_buffer_t){.data = buffer, .size = size};
+  // The descriptor must be visible before the ISR can observe the new head.
+  __atomic_signal_fence(__ATOMIC_RELEASE);
+  ++stream->head;
+
+  return true;
+}
+
+void uart_stream_rx_handle_irq(uart_stream_rx_t *stream, dif_uart_irq_t irq) {
+  ++stream->irq_count;
+
+  CHECK(dif_uart_irq_acknowledge(stream->uart, irq) == kDifUartOk,
+        "ISR failed to clear IRQ!");
+
+  switch (irq) {
+    case kDifUartIrqRxWatermark:
+      if (stream->packet_mode) {
+        // Leave a byte behind, so that the RX timeout still fires at the end
+        // of the packet; it only does while the RX FIFO is not empty.
+        size_t level;
+        CHECK(dif_uart_rx_bytes_available(stream->uart, &level) ==
+              kDifUartOk);
+        if (level > 1) {
+          stream_drain(stream, level - 1);
+        }
+      } else {
+        stream_drain(stream, SIZE_MAX);
+      }
+      break;
+    case kDifUartIrqRxTimeout:
+      stream_drain(stream, SIZE_MAX);
+      if (stream->packet_mode) {
+        stream_end_packet(stream);
+      }
+      break;
+    default:
+      LOG_FATAL("UART IRQ %d is not handled by the stream!", irq);
+      test_status_set(kTestStatusFailed);
+  }
+}
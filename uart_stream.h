@@ -0,0 +1,150 @@
+// Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+// Licensed under the BCI License. See LICENSE for details.
+
+#ifndef ATHOS_SW_DIF_SMOKETEST_UART_STREAM_H_
+#define ATHOS_SW_DIF_SMOKETEST_UART_STREAM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dif/dif_uart.h"
+
+/**
+ * Zero-copy streaming UART receive.
+ *
+ * The caller hands its own buffers to the stream, and the RX watermark / RX
+ * timeout interrupts read the RX FIFO straight into them; there is no
+ * intermediate ring and no size limit beyond the buffers themselves. When no
+ * buffer is queued, each drained FIFO chunk is passed to the callback
+ * instead, so that a consumer that only inspects the data (e.g. a checksum)
+ * needs no buffer at all.
+ *
+ * In packet mode the RX timeout marks the end of a packet: the buffer being
+ * filled is handed to the callback with the length of the packet, instead of
+ * when it is full, so a variable length message takes a single buffer and,
+ * up to the RX watermark, a single interrupt. When no buffer is partially
+ * filled at that point, the end of the packet is reported as a call with no
+ * data instead.
+ */
+
+enum {
+  /**
+   * Maximum number of buffers queued on a stream at a time.
+   */
+  kUartStreamMaxBuffers = 4,
+};
+
+/**
+ * Receives data from the stream.
+ *
+ * Called from the ISR, either with a queued buffer once it has been filled,
+ * or with a transient chunk (only valid during the call) when no buffer was
+ * queued. In packet mode, also called with a partially filled buffer, or with
+ * `data` NULL and `len` zero, at the end of each packet.
+ *
+ * @param ctx Context registered with the stream.
+ * @param data Received data.
+ * @param len Number of bytes in `data`.
+ */
+typedef void (*uart_stream_rx_cb_t)(void *ctx, uint8_t *data, size_t len);
+
+typedef struct uart_stream_buffer {
+  uint8_t *data;
+  size_t size;
+} uart_stream_buffer_t;
+
+typedef struct uart_stream_rx {
+  const dif_uart_t *uart;
+  uart_stream_rx_cb_t callback;
+  void *ctx;
+  /**
+   * Queue of submitted buffers; `head` is only written by
+   * `uart_stream_rx_submit()` and `tail` only by the ISR.
+   */
+  uart_stream_buffer_t buffers[kUartStreamMaxBuffers];
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  /**
+   * Bytes already received into the buffer at `tail`.
+   */
+  volatile size_t fill;
+  /**
+   * Total number of bytes received.
+   */
+  volatile uint32_t received;
+  /**
+   * Number of UART interrupts serviced by the stream.
+   */
+  volatile uint32_t irq_count;
+  /**
+   * Whether the RX timeout ends a packet.
+   */
+  bool packet_mode;
+  /**
+   * Bytes received of the packet in progress.
+   */
+  size_t packet_bytes;
+  /**
+   * Number of packets ended by the RX timeout.
+   */
+  volatile uint32_t packets;
+} uart_stream_rx_t;
+
+/**
+ * Initialises `stream` and enables the RX watermark and RX timeout interrupts
+ * of `uart`.
+ *
+ * The UART must have been initialised and configured by the caller, and the
+ * caller is responsible for routing the UART interrupts through the PLIC to
+ * `uart_stream_rx_handle_irq()`.
+ *
+ * @param stream Stream to initialise.
+ * @param uart UART to receive from.
+ * @param rx_timeout_bits RX idle time, in bit times, after which the bytes
+ *        below the RX watermark are collected.
+ * @param callback Receives filled buffers, or chunks if no buffer is queued.
+ * @param ctx Passed to `callback`.
+ */
+void uart_stream_rx_init(uart_stream_rx_t *stream, const dif_uart_t *uart,
+                         uint32_t rx_timeout_bits,
+                         uart_stream_rx_cb_t callback, void *ctx);
+
+/**
+ * Disables the RX watermark and RX timeout interrupts of the stream's UART.
+ *
+ * Queued buffers are abandoned; the stream must be initialised again to be
+ * reused.
+ */
+void uart_stream_rx_stop(uart_stream_rx_t *stream);
+
+/**
+ * Enables or disables packet mode; disabled by `uart_stream_rx_init()`.
+ *
+ * Packet mode needs a non-zero RX timeout, which sets the idle time that
+ * separates two packets.
+ */
+void uart_stream_rx_set_packet_mode(uart_stream_rx_t *stream, bool enabled);
+
+/**
+ * Queues `buffer` to be filled with received data.
+ *
+ * Buffers are filled in submission order. Must not be called from an ISR.
+ *
+ * @return False if `kUartStreamMaxBuffers` buffers are already queued.
+ */
+bool uart_stream_rx_submit(uart_stream_rx_t *stream, uint8_t *buffer,
+                           size_t size);
+
+/**
+ * Services a UART RX watermark / RX timeout interrupt on behalf of the
+ * stream.
+ *
+ * Acknowledges the interrupt.
+ *
+ * @param stream Stream that owns the interrupting UART.
+ * @param irq The UART interrupt that has fired.
+ */
+void uart_stream_rx_handle_irq(uart_stream_rx_t *stream, dif_uart_irq_t irq);
+
+#endif  // ATHOS_SW_DIF_SMOKETEST_UART_STREAM_H_
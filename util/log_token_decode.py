@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+# Copyright (C) May 2022, Belmont Computing, Inc. -- All Rights Reserved
+# Licensed under the BCI License. See LICENSE for details.
+"""Decodes tokenized log records (see log_token.h) back into text.
+
+The device only transmits a sync byte, an argument count, a token and the raw
+32-bit arguments; the severity, source location and format string of every
+token live in the `.logs.fields` section of the test ELF. Everything on the
+stream that is not a record is passed through unchanged.
+
+Usage:
+  log_token_decode.py dif_rv_timer_smoketest.elf < uart.bin
+  log_token_decode.py dif_rv_timer_smoketest.elf uart.bin
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+LOG_TOKEN_SYNC = 0xA5
+LOG_TOKEN_MAX_ARGS = 8
+LOGS_SECTION = ".logs.fields"
+
+_CONVERSION = re.compile(
+    r"%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z)?([diuxXcpso%])")
+
+
+def read_logs_section(elf_path):
+    """Returns (load address, contents) of the `.logs.fields` section."""
+    with open(elf_path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+        sys.exit("{}: not a little-endian ELF32 file".format(elf_path))
+
+    shoff, = struct.unpack_from("<I", elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+
+    def section(index):
+        return struct.unpack_from("<IIIIII", elf, shoff + index * shentsize)
+
+    _, _, _, _, strtab_offset, _ = section(shstrndx)
+    for index in range(shnum):
+        name, _, _, addr, offset, size = section(index)
+        end = elf.index(b"\0", strtab_offset + name)
+        if elf[strtab_offset + name:end].decode() == LOGS_SECTION:
+            return addr, elf[offset:offset + size]
+    sys.exit("{}: no {} section".format(elf_path, LOGS_SECTION))
+
+
+def format_c(fmt, args):
+    """Expands the integer conversions of a C format string."""
+    args = iter(args)
+
+    def expand(match):
+        flags, width, precision, conv = match.groups()
+        if conv == "%":
+            return "%"
+        value = next(args, None)
+        if value is None:
+            return "<missing>"
+        if conv in "di":
+            value -= (value & 0x80000000) << 1
+        elif conv == "c":
+            value = chr(value & 0xFF)
+        elif conv == "p":
+            return "0x{:08x}".format(value)
+        elif conv == "s":
+            return "<str@0x{:08x}>".format(value)
+        spec = "%" + flags + width
+        if precision:
+            spec += "." + precision
+        return (spec + {"u": "d"}.get(conv, conv)) % value
+
+    return _CONVERSION.sub(expand, fmt)
+
+
+def decode(stream, base, strings, out):
+    """Decodes `stream`, writing text to `out`."""
+    data = stream.read()
+    pos = 0
+    while pos < len(data):
+        sync = data.find(bytes([LOG_TOKEN_SYNC]), pos)
+        if sync < 0:
+            out.write(data[pos:].decode("ascii", "replace"))
+            break
+        out.write(data[pos:sync].decode("ascii", "replace"))
+
+        header = data[sync + 1:sync + 6]
+        if len(header) < 5 or header[0] > LOG_TOKEN_MAX_ARGS:
+            out.write("<bad record>\n")
+            pos = sync + 1
+            continue
+        nargs = header[0]
+        if sync + 6 + 4 * nargs > len(data):
+            out.write("<truncated record>\n")
+            break
+        token, = struct.unpack_from("<I", header, 1)
+        args = struct.unpack_from("<{}I".format(nargs), data, sync + 6)
+        pos = sync + 6 + 4 * nargs
+
+        offset = token - base
+        if not 0 <= offset < len(strings):
+            out.write("<unknown token 0x{:08x}>\n".format(token))
+            continue
+        location, fmt = strings[offset:].split(b"\0", 2)[:2]
+        location = location.decode()
+        out.write("{} {}] {}\n".format(location[0], location[1:],
+                                       format_c(fmt.decode(), args)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="ELF of the test that produced the log")
+    parser.add_argument("input", nargs="?", help="raw UART capture "
+                        "(default: stdin)")
+    args = parser.parse_args()
+
+    base, strings = read_logs_section(args.elf)
+    if args.input:
+        with open(args.input, "rb") as stream:
+            decode(stream, base, strings, sys.stdout)
+    else:
+        decode(sys.stdin.buffer, base, strings, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()